@@ -0,0 +1,5332 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <array>
+#include <charconv>
+#include <thread>
+#include <exception>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <cstddef>
+#include <string_view>
+#include <stdint.h>
+#include <type_traits>
+#include <cmath>
+#include <chrono>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// 属性类型
+enum class PropertyType {
+    CHAR,
+    UCHAR,
+    SHORT,
+    USHORT,
+    INT,
+    UINT,
+    FLOAT,
+    DOUBLE,
+    UNKNOWN
+};
+
+// 定义类型信息模板，用于获取类型的名称和大小
+template<typename T>
+struct TypeInfo;
+
+#define DEFINE_TYPE_INFO(type, typeName, typeEnum)    \
+template<>                                  \
+struct TypeInfo<type> {                     \
+    static constexpr const char* getName() { return typeName; }  \
+    static constexpr size_t getSize() { return sizeof(type); }   \
+    static constexpr PropertyType getType() { return typeEnum; } \
+};
+
+// 为基本类型提供特化版本
+DEFINE_TYPE_INFO(char, "char", PropertyType::CHAR)
+DEFINE_TYPE_INFO(unsigned char, "uchar", PropertyType::UCHAR)
+DEFINE_TYPE_INFO(short, "short", PropertyType::SHORT)
+DEFINE_TYPE_INFO(unsigned short, "ushort", PropertyType::USHORT)
+DEFINE_TYPE_INFO(int, "int", PropertyType::INT)
+DEFINE_TYPE_INFO(unsigned int, "uint", PropertyType::UINT)
+DEFINE_TYPE_INFO(float, "float", PropertyType::FLOAT)
+DEFINE_TYPE_INFO(double, "double", PropertyType::DOUBLE)
+
+// 类型名到属性类型，兼容 int8/uint8/.../float64 写法
+inline PropertyType propertyTypeFromName(const std::string& name) {
+    if (name == "char" || name == "int8") return PropertyType::CHAR;
+    if (name == "uchar" || name == "uint8") return PropertyType::UCHAR;
+    if (name == "short" || name == "int16") return PropertyType::SHORT;
+    if (name == "ushort" || name == "uint16") return PropertyType::USHORT;
+    if (name == "int" || name == "int32") return PropertyType::INT;
+    if (name == "uint" || name == "uint32") return PropertyType::UINT;
+    if (name == "float" || name == "float32") return PropertyType::FLOAT;
+    if (name == "double" || name == "float64") return PropertyType::DOUBLE;
+    return PropertyType::UNKNOWN;
+}
+
+// 属性类型的字节数，未知类型返回 0
+inline size_t propertyTypeSize(PropertyType type) {
+    switch (type) {
+        case PropertyType::CHAR:
+        case PropertyType::UCHAR:
+            return 1;
+        case PropertyType::SHORT:
+        case PropertyType::USHORT:
+            return 2;
+        case PropertyType::INT:
+        case PropertyType::UINT:
+        case PropertyType::FLOAT:
+            return 4;
+        case PropertyType::DOUBLE:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+// 成员信息：（名称, 类型名, 大小, 成员指针, 偏移），全部是编译期常量
+// 成员指针的类型必须与声明的 MemberType 一致，否则编译失败
+template<typename MemberType, typename VertexType>
+constexpr auto memberInfo(const char* name, MemberType VertexType::* member, size_t offset) {
+    return std::make_tuple(name, TypeInfo<MemberType>::getName(), sizeof(MemberType), member, offset);
+}
+
+// 宏：用于定义结构体并注册成员
+#define REFLECTABLE(...) \
+    static constexpr auto getMembers() { return std::make_tuple(__VA_ARGS__); }
+
+#define MEMBER_INFO(type, member, memberType) \
+    memberInfo<memberType, type>(#member, &type::member, offsetof(type, member))
+
+#pragma pack(push, 1)
+// 示例结构体
+struct CustomVertex {
+    float x, y, z;
+    unsigned char r, g, b;
+    // 使用宏注册结构体成员
+    REFLECTABLE(
+        MEMBER_INFO(CustomVertex, x, float),
+        MEMBER_INFO(CustomVertex, y, float), 
+        MEMBER_INFO(CustomVertex, z, float), 
+        MEMBER_INFO(CustomVertex, r, unsigned char),
+        MEMBER_INFO(CustomVertex, g, unsigned char),
+        MEMBER_INFO(CustomVertex, b, unsigned char)
+    )
+};
+#pragma pack(pop)
+
+// 重载输出操作符 <<
+inline std::ostream& operator<<(std::ostream& os, const CustomVertex& vertex) {
+    os << "Position: (" << vertex.x << ", " << vertex.y << ", " << vertex.z << ") ";
+    os << "Color: (" << static_cast<int>(vertex.r) << ", " << static_cast<int>(vertex.g) << ", " << static_cast<int>(vertex.b) << ")";
+    //os << "intensity: " << vertex.intensity;
+    return os;
+}
+
+// 重载输入操作符 >>
+inline std::istream& operator>>(std::istream& is, CustomVertex& vertex) {
+    int r, g, b;
+    is >> vertex.x >> vertex.y >> vertex.z >> r >> g >> b;
+    vertex.r = static_cast<unsigned char>(r);
+    vertex.g = static_cast<unsigned char>(g);
+    vertex.b = static_cast<unsigned char>(b);
+    return is;
+}
+
+inline bool isLittleEndian() {
+    unsigned int x = 1;
+    char *ptr = (char*)&x;
+    return ptr[0] == 1;
+}
+
+// 字节序转换函数：大端到小端，或小端到大端
+template<typename T>
+T swapEndian(T value) {
+    static_assert(std::is_trivially_copyable_v<T>, "必须是可复制的基本类型");
+    T result;
+    auto valuePtr = reinterpret_cast<unsigned char*>(&value);
+    auto resultPtr = reinterpret_cast<unsigned char*>(&result);
+    for (size_t i = 0; i < sizeof(T); i++) {
+        resultPtr[i] = valuePtr[sizeof(T) - 1 - i];
+    }
+    return result;
+}
+
+constexpr size_t constexprLength(const char* text) {
+    size_t length = 0;
+    while (text[length] != '\0') length++;
+    return length;
+}
+
+// 各成员的（偏移, 大小）
+template<typename Members, size_t... I>
+constexpr auto schemaFields(const Members& members, std::index_sequence<I...>) {
+    return std::array<std::pair<size_t, size_t>, sizeof...(I)>{{
+        {std::get<4>(std::get<I>(members)), std::get<2>(std::get<I>(members))}...}};
+}
+
+// 成员都在结构体内且互不重叠
+template<typename Fields>
+constexpr bool schemaFieldsValid(const Fields& fields, size_t structSize) {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (fields[i].first + fields[i].second > structSize) return false;
+        for (size_t j = 0; j < i; j++) {
+            if (fields[i].first < fields[j].first + fields[j].second && fields[j].first < fields[i].first + fields[i].second) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 成员按注册顺序首尾相接、没有填充，且恰好占满结构体
+template<typename Fields>
+constexpr bool schemaFieldsPacked(const Fields& fields, size_t structSize) {
+    size_t next = 0;
+    for (const auto& field : fields) {
+        if (field.first != next) return false;
+        next += field.second;
+    }
+    return next == structSize;
+}
+
+template<typename Members>
+constexpr size_t schemaPropertiesLength(const Members& members) {
+    size_t length = 0;
+    std::apply([&](const auto&... member) {
+        ((length += constexprLength("property ") + constexprLength(std::get<1>(member)) + 1 +
+                    constexprLength(std::get<0>(member)) + 1), ...);
+    }, members);
+    return length;
+}
+
+// 头部中的属性行，末尾带 '\0'
+template<size_t Length, typename Members>
+constexpr std::array<char, Length + 1> schemaProperties(const Members& members) {
+    std::array<char, Length + 1> text{};
+    size_t pos = 0;
+    auto append = [&](const char* part) {
+        while (*part != '\0') text[pos++] = *part++;
+    };
+    std::apply([&](const auto&... member) {
+        ((append("property "), append(std::get<1>(member)), append(" "), append(std::get<0>(member)), append("\n")), ...);
+    }, members);
+    return text;
+}
+
+// 结构体的编译期描述：成员布局检查、头部属性文本，以及能否整体 memcpy
+template<typename VertexType>
+struct PlySchema {
+    static constexpr auto members = VertexType::getMembers();
+    static constexpr size_t count = std::tuple_size_v<std::decay_t<decltype(members)>>;
+    static constexpr auto fields = schemaFields(members, std::make_index_sequence<count>{});
+    // 没有填充：内存布局与文件记录一致（都是系统字节序时），读写都可以整体拷贝
+    static constexpr bool isPacked = schemaFieldsPacked(fields, sizeof(VertexType));
+    static constexpr auto propertiesText = schemaProperties<schemaPropertiesLength(members)>(members);
+
+    static_assert(schemaFieldsValid(fields, sizeof(VertexType)), "成员越界或相互重叠");
+
+    static std::string_view properties() { return std::string_view(propertiesText.data(), propertiesText.size() - 1); }
+};
+
+// 遍历结构体注册的成员：func(名称, 类型, 大小, 偏移)
+template<typename VertexType, typename Func>
+void forEachMember(Func&& func) {
+    std::apply([&](const auto&... member) {
+        (func(std::string(std::get<0>(member)), propertyTypeFromName(std::get<1>(member)),
+              std::get<2>(member), std::get<4>(member)), ...);
+    }, PlySchema<VertexType>::members);
+}
+
+// PLY 头部中的一个属性，或结构体中的一个成员
+struct PlyProperty {
+    std::string name;
+    PropertyType type = PropertyType::UNKNOWN;
+    size_t size = 0;
+    size_t offset = 0;  // 在一条记录中的字节偏移（列表属性之后的属性偏移不固定）
+    bool isList = false;  // list 属性：type 为元素类型，countType 为长度类型，size 为 0
+    PropertyType countType = PropertyType::UNKNOWN;
+};
+
+// 结构体 getMembers() 描述的记录布局
+template<typename VertexType>
+std::vector<PlyProperty> vertexLayout() {
+    std::vector<PlyProperty> layout;
+    forEachMember<VertexType>([&](const std::string& name, PropertyType type, size_t size, size_t offset) {
+        layout.push_back(PlyProperty{name, type, size, offset});
+    });
+    return layout;
+}
+
+// layout（例如文件头部）与结构体成员逐一相同：名称、类型、顺序一致且没有多余属性
+template<typename VertexType>
+bool matchesSchema(const std::vector<PlyProperty>& layout) {
+    if (layout.size() != PlySchema<VertexType>::count) return false;
+    size_t i = 0;
+    bool same = true;
+    std::apply([&](const auto&... member) {
+        ((same = same && layout[i].name == std::get<0>(member) && !layout[i].isList &&
+                 layout[i].type == propertyTypeFromName(std::get<1>(member)), i++), ...);
+    }, PlySchema<VertexType>::members);
+    return same;
+}
+
+// 按顺序紧密排列（无填充）后的布局，即写入文件时的记录布局
+inline std::vector<PlyProperty> packedLayout(std::vector<PlyProperty> layout) {
+    size_t offset = 0;
+    for (auto& property : layout) {
+        property.offset = offset;
+        offset += property.size;
+    }
+    return layout;
+}
+
+// 布局中所有字段的总字节数
+inline size_t layoutSize(const std::vector<PlyProperty>& layout) {
+    size_t size = 0;
+    for (const auto& property : layout) size += property.size;
+    return size;
+}
+
+// 顶点位置，用于建立空间索引
+struct PlyPosition {
+    float x, y, z;
+    REFLECTABLE(
+        MEMBER_INFO(PlyPosition, x, float),
+        MEMBER_INFO(PlyPosition, y, float),
+        MEMBER_INFO(PlyPosition, z, float)
+    )
+};
+
+// 轴对齐包围盒
+struct PlyBounds {
+    std::array<float, 3> min{{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()}};
+    std::array<float, 3> max{{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()}};
+
+    bool empty() const { return min[0] > max[0] || min[1] > max[1] || min[2] > max[2]; }
+
+    void expand(const PlyPosition& p) {
+        min[0] = std::min(min[0], p.x), max[0] = std::max(max[0], p.x);
+        min[1] = std::min(min[1], p.y), max[1] = std::max(max[1], p.y);
+        min[2] = std::min(min[2], p.z), max[2] = std::max(max[2], p.z);
+    }
+
+    void expand(const PlyBounds& other) {
+        for (int i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], other.min[i]);
+            max[i] = std::max(max[i], other.max[i]);
+        }
+    }
+
+    bool contains(const PlyPosition& p) const {
+        return p.x >= min[0] && p.x <= max[0] && p.y >= min[1] && p.y <= max[1] && p.z >= min[2] && p.z <= max[2];
+    }
+
+    bool intersects(const PlyBounds& other) const {
+        for (int i = 0; i < 3; i++) {
+            if (other.max[i] < min[i] || other.min[i] > max[i]) return false;
+        }
+        return true;
+    }
+};
+
+// 头部中的一个元素（vertex、face 等）
+struct PlyElement {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+    size_t offset = npos;  // 数据在文件中的起始位置，前面有变长元素时为 npos，由 PlyReader 扫描得到
+
+    bool hasList() const {
+        for (const auto& property : properties) {
+            if (property.isList) return true;
+        }
+        return false;
+    }
+
+    // 定长元素每条记录的字节数
+    size_t recordSize() const { return layoutSize(properties); }
+};
+
+// 解析后的 PLY 头部
+struct PlyHeader {
+    bool isBinary = true;
+    bool littleEndian = true;
+    bool quantized = false;  // format binary_quantized：分块量化压缩的顶点，见 PlyQuantizedCodec
+    size_t vertexCount = 0;
+    std::vector<PlyProperty> properties;  // vertex 元素的属性
+    size_t dataOffset = 0;  // vertex 数据的起始位置
+    size_t headerSize = 0;  // end_header 之后第一个字节的位置
+    std::vector<PlyElement> elements;
+    bool hasBounds = false;  // 头部带有 obj_info bbox 行（见 PlyWriteOptions::boundsInHeader）
+    PlyBounds bounds;
+
+    size_t vertexSize() const {
+        size_t size = 0;
+        for (const auto& property : properties) size += property.size;
+        return size;
+    }
+
+    const PlyElement* findElement(const std::string& name) const {
+        for (const auto& element : elements) {
+            if (element.name == name) return &element;
+        }
+        return nullptr;
+    }
+};
+
+// 从流中解析头部，返回后流位于第一个元素的数据起始处
+inline PlyHeader parseHeader(std::istream& stream) {
+    PlyHeader header;
+    std::string line;
+    if (!std::getline(stream, line) || line.compare(0, 3, "ply") != 0) {
+        throw std::runtime_error("Not a PLY file");
+    }
+    bool ended = false;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line == "end_header") {
+            ended = true;
+            break;
+        }
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            header.isBinary = format != "ascii";
+            header.littleEndian = format != "binary_big_endian";
+            header.quantized = format == "binary_quantized";
+        } else if (keyword == "obj_info") {
+            std::string key;
+            PlyBounds bounds;
+            if (tokens >> key && key == "bbox" &&
+                tokens >> bounds.min[0] >> bounds.min[1] >> bounds.min[2] >> bounds.max[0] >> bounds.max[1] >> bounds.max[2]) {
+                header.bounds = bounds;
+                header.hasBounds = true;
+            }
+        } else if (keyword == "element") {
+            PlyElement element;
+            tokens >> element.name >> element.count;
+            header.elements.push_back(element);
+        } else if (keyword == "property" && !header.elements.empty()) {
+            PlyElement& element = header.elements.back();
+            PlyProperty property;
+            std::string type;
+            tokens >> type;
+            if (type == "list") {
+                std::string countType;
+                tokens >> countType >> type;
+                property.isList = true;
+                property.countType = propertyTypeFromName(countType);
+            }
+            tokens >> property.name;
+            property.type = propertyTypeFromName(type);
+            property.size = property.isList ? 0 : propertyTypeSize(property.type);
+            property.offset = element.recordSize();
+            element.properties.push_back(property);
+        }
+    }
+    if (!ended) {
+        throw std::runtime_error("PLY header is missing end_header");
+    }
+    header.headerSize = static_cast<size_t>(stream.tellg());
+
+    // 定长元素依次排列，遇到变长（含 list）元素后的位置要扫描数据才能确定
+    size_t offset = header.headerSize;
+    header.dataOffset = header.headerSize;
+    for (auto& element : header.elements) {
+        element.offset = offset;
+        if (offset != PlyElement::npos) {
+            offset = element.hasList() ? PlyElement::npos : offset + element.count * element.recordSize();
+        }
+        if (element.name == "vertex") {
+            header.vertexCount = element.count;
+            header.properties = element.properties;
+            header.dataOffset = element.offset;
+        }
+    }
+    return header;
+}
+
+// 头部在 data 中的字节数（含 end_header 行的换行），头部不完整时返回 0
+inline size_t findHeaderEnd(const char* data, size_t size) {
+    static const char endTag[] = "end_header";
+    const char* end = data + size;
+    const char* tag = std::search(data, end, endTag, endTag + sizeof(endTag) - 1);
+    const char* lineEnd = tag == end ? end : std::find(tag, end, '\n');
+    return lineEnd == end ? 0 : static_cast<size_t>(lineEnd + 1 - data);
+}
+
+// 从内存中解析头部
+inline PlyHeader parseHeader(const char* data, size_t size) {
+    const size_t length = findHeaderEnd(data, size);
+    if (length == 0) {
+        throw std::runtime_error("PLY header is missing end_header");
+    }
+    std::istringstream stream(std::string(data, length));
+    return parseHeader(stream);
+}
+
+// 按属性类型分派到对应的 C++ 类型：func(T())
+template<typename Func>
+void dispatchPropertyType(PropertyType type, Func&& func) {
+    switch (type) {
+        case PropertyType::CHAR: func(char()); break;
+        case PropertyType::UCHAR: func((unsigned char)0); break;
+        case PropertyType::SHORT: func(short()); break;
+        case PropertyType::USHORT: func((unsigned short)0); break;
+        case PropertyType::INT: func(int()); break;
+        case PropertyType::UINT: func((unsigned int)0); break;
+        case PropertyType::FLOAT: func(float()); break;
+        case PropertyType::DOUBLE: func(double()); break;
+        default: throw std::runtime_error("Unsupported property type");
+    }
+}
+
+// 属性类型在头部中的名称
+inline std::string propertyTypeName(PropertyType type) {
+    std::string name;
+    dispatchPropertyType(type, [&](auto value) { name = TypeInfo<decltype(value)>::getName(); });
+    return name;
+}
+
+// 数值转换，浮点转整数时先截断到目标范围，避免未定义行为
+template<typename Dst, typename Src>
+Dst convertValue(Src value) {
+    if constexpr (std::is_floating_point_v<Src> && std::is_integral_v<Dst>) {
+        if (!(value == value)) return Dst(0);
+        if (value <= static_cast<Src>(std::numeric_limits<Dst>::lowest())) return std::numeric_limits<Dst>::lowest();
+        if (value >= static_cast<Src>(std::numeric_limits<Dst>::max())) return std::numeric_limits<Dst>::max();
+    }
+    return static_cast<Dst>(value);
+}
+
+// 在一整块顶点上按列转换一个字段
+template<typename Src, typename Dst>
+void convertColumn(const char* src, size_t srcStride, char* dst, size_t dstStride, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        Src value;
+        std::memcpy(&value, src + i * srcStride, sizeof(Src));
+        Dst result = convertValue<Dst>(value);
+        std::memcpy(dst + i * dstStride, &result, sizeof(Dst));
+    }
+}
+
+// 在一整块顶点上按列拷贝一段连续字节，定长时编译器可展开 memcpy
+template<size_t N>
+void copyColumn(const char* src, size_t srcStride, char* dst, size_t dstStride, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        std::memcpy(dst + i * dstStride, src + i * srcStride, N);
+    }
+}
+
+#if defined(__AVX2__)
+// 解交错：把跨步的 4/8 字节字段收集到连续数组（AVX2 gather）
+inline void gatherColumn(const char* src, size_t srcStride, char* dst, size_t size, size_t count) {
+    size_t i = 0;
+    if (srcStride <= static_cast<size_t>(std::numeric_limits<int>::max() / 8)) {
+        const int stride = static_cast<int>(srcStride);
+        if (size == 4) {
+            const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+            for (; i + 8 <= count; i += 8) {
+                const __m256i value = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src + i * srcStride), index, 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), value);
+            }
+        } else {
+            const __m128i index = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(stride));
+            for (; i + 4 <= count; i += 4) {
+                const __m256i value = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(src + i * srcStride), index, 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 8), value);
+            }
+        }
+    }
+    for (; i < count; i++) {
+        std::memcpy(dst + i * size, src + i * srcStride, size);
+    }
+}
+#endif
+
+#if defined(__AVX512F__)
+// 交错：把连续数组中的 4/8 字节字段分散写回跨步记录（AVX-512 scatter）
+inline void scatterColumn(const char* src, char* dst, size_t dstStride, size_t size, size_t count) {
+    size_t i = 0;
+    if (dstStride <= static_cast<size_t>(std::numeric_limits<int>::max() / 16)) {
+        const int stride = static_cast<int>(dstStride);
+        if (size == 4) {
+            const __m512i index = _mm512_mullo_epi32(
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(stride));
+            for (; i + 16 <= count; i += 16) {
+                _mm512_i32scatter_epi32(dst + i * dstStride, index, _mm512_loadu_si512(src + i * 4), 1);
+            }
+        } else {
+            const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+            for (; i + 8 <= count; i += 8) {
+                _mm512_i32scatter_epi64(dst + i * dstStride, index, _mm512_loadu_si512(src + i * 8), 1);
+            }
+        }
+    }
+    for (; i < count; i++) {
+        std::memcpy(dst + i * dstStride, src + i * size, size);
+    }
+}
+#endif
+
+inline void copyColumn(const char* src, size_t srcStride, char* dst, size_t dstStride, size_t size, size_t count) {
+#if defined(__AVX2__)
+    if (dstStride == size && srcStride != size && (size == 4 || size == 8)) {
+        gatherColumn(src, srcStride, dst, size, count);
+        return;
+    }
+#endif
+#if defined(__AVX512F__)
+    if (srcStride == size && dstStride != size && (size == 4 || size == 8)) {
+        scatterColumn(src, dst, dstStride, size, count);
+        return;
+    }
+#endif
+    switch (size) {
+        case 1: copyColumn<1>(src, srcStride, dst, dstStride, count); break;
+        case 2: copyColumn<2>(src, srcStride, dst, dstStride, count); break;
+        case 3: copyColumn<3>(src, srcStride, dst, dstStride, count); break;
+        case 4: copyColumn<4>(src, srcStride, dst, dstStride, count); break;
+        case 8: copyColumn<8>(src, srcStride, dst, dstStride, count); break;
+        case 12: copyColumn<12>(src, srcStride, dst, dstStride, count); break;
+        case 16: copyColumn<16>(src, srcStride, dst, dstStride, count); break;
+        default:
+            for (size_t i = 0; i < count; i++) {
+                std::memcpy(dst + i * dstStride, src + i * srcStride, size);
+            }
+    }
+}
+
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define PLY_HAS_BYTE_SHUFFLE 1
+// 按掩码重排 p 处的 16 个字节
+inline void shuffleBytes16(char* p, const unsigned char* mask) {
+#if defined(__SSSE3__)
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i order = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(value, order));
+#else
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(p);
+    vst1q_u8(bytes, vqtbl1q_u8(vld1q_u8(bytes), vld1q_u8(mask)));
+#endif
+}
+#endif
+
+// 整块数据的字节序翻转：按记录布局把每个 2/4/8 字节字段原地翻转
+// 有 SSSE3/NEON 时用 16 字节 shuffle，一次处理多个字段；否则逐字段标量翻转
+class EndianSwapper {
+public:
+    EndianSwapper() = default;
+    EndianSwapper(const std::vector<std::pair<size_t, size_t>>& fields, size_t stride) : stride_(stride) {
+        for (const auto& field : fields) {
+            if (field.second > 1) fields_.push_back(field);
+        }
+        std::sort(fields_.begin(), fields_.end());
+        buildMasks();
+    }
+
+    // 按属性列表描述的记录布局
+    static EndianSwapper forLayout(const std::vector<PlyProperty>& layout, size_t stride) {
+        std::vector<std::pair<size_t, size_t>> fields;
+        for (const auto& property : layout) {
+            fields.emplace_back(property.offset, property.size);
+        }
+        return EndianSwapper(fields, stride);
+    }
+
+    // 按文件头部中的属性布局
+    static EndianSwapper forHeader(const PlyHeader& header) {
+        return forLayout(header.properties, header.vertexSize());
+    }
+
+    // 按结构体 getMembers() 的布局
+    template<typename VertexType>
+    static EndianSwapper forVertex() {
+        return forLayout(vertexLayout<VertexType>(), sizeof(VertexType));
+    }
+
+    bool empty() const { return fields_.empty(); }
+
+    // 原地翻转 count 条记录
+    void apply(char* data, size_t count) const {
+        if (fields_.empty() || count == 0) return;
+        size_t done = 0;
+#ifdef PLY_HAS_BYTE_SHUFFLE
+        const size_t total = count * stride_;
+        if (!periodMasks_.empty()) {
+            // 整周期处理：period 字节恰好包含若干完整记录，且没有字段跨 16 字节边界
+            const size_t period = periodMasks_.size() * 16;
+            const size_t periods = total / period;
+            for (size_t p = 0; p < periods; p++) {
+                char* base = data + p * period;
+                for (size_t k = 0; k < periodMasks_.size(); k++) {
+                    shuffleBytes16(base + k * 16, periodMasks_[k].data());
+                }
+            }
+            done = periods * period / stride_;
+        } else if (!windows_.empty()) {
+            // 逐记录处理：每个窗口覆盖一组完整字段，越界的尾部记录交给标量路径
+            const size_t reach = windows_.back().offset + 16;
+            while (done < count && done * stride_ + reach <= total) {
+                char* record = data + done * stride_;
+                for (const auto& window : windows_) {
+                    shuffleBytes16(record + window.offset, window.mask.data());
+                }
+                done++;
+            }
+        }
+#endif
+        for (size_t i = done; i < count; i++) {
+            char* record = data + i * stride_;
+            for (const auto& field : fields_) {
+                swapField(record + field.first, field.second);
+            }
+        }
+    }
+
+private:
+    struct Window {
+        size_t offset;
+        std::array<unsigned char, 16> mask;
+    };
+
+    static void swapField(char* p, size_t size) {
+        switch (size) {
+            case 2: swapValue<uint16_t>(p); break;
+            case 4: swapValue<uint32_t>(p); break;
+            case 8: swapValue<uint64_t>(p); break;
+            default: std::reverse(p, p + size); break;
+        }
+    }
+
+    template<typename T>
+    static void swapValue(char* p) {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        value = swapEndian(value);
+        std::memcpy(p, &value, sizeof(T));
+    }
+
+    static std::array<unsigned char, 16> identityMask() {
+        std::array<unsigned char, 16> mask;
+        for (unsigned char i = 0; i < 16; i++) mask[i] = i;
+        return mask;
+    }
+
+    void buildMasks() {
+        if (fields_.empty() || stride_ == 0) return;
+
+        // 周期 = lcm(stride, 16)，只在不太长且没有字段跨 16 字节边界时使用
+        size_t period = 16;
+        while (period % stride_ != 0 && period <= 256) period += 16;
+        bool aligned = period % stride_ == 0;
+        for (size_t base = 0; aligned && base < period; base += stride_) {
+            for (const auto& field : fields_) {
+                const size_t begin = base + field.first;
+                if (begin / 16 != (begin + field.second - 1) / 16) aligned = false;
+            }
+        }
+        if (aligned) {
+            periodMasks_.assign(period / 16, identityMask());
+            for (size_t base = 0; base < period; base += stride_) {
+                for (const auto& field : fields_) {
+                    const size_t begin = base + field.first;
+                    auto& mask = periodMasks_[begin / 16];
+                    for (size_t i = 0; i < field.second; i++) {
+                        mask[(begin + i) % 16] = static_cast<unsigned char>((begin + field.second - 1 - i) % 16);
+                    }
+                }
+            }
+            return;
+        }
+
+        // 否则每条记录按若干 16 字节窗口处理，字段不超过 16 字节时总能放入某个窗口
+        for (const auto& field : fields_) {
+            if (field.second > 16) return;
+        }
+        size_t i = 0;
+        while (i < fields_.size()) {
+            Window window{fields_[i].first, identityMask()};
+            while (i < fields_.size() && fields_[i].first + fields_[i].second <= window.offset + 16) {
+                const size_t begin = fields_[i].first - window.offset;
+                for (size_t k = 0; k < fields_[i].second; k++) {
+                    window.mask[begin + k] = static_cast<unsigned char>(begin + fields_[i].second - 1 - k);
+                }
+                i++;
+            }
+            windows_.push_back(window);
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> fields_;  // (偏移, 大小)，只含多字节字段
+    size_t stride_ = 0;
+    std::vector<std::array<unsigned char, 16>> periodMasks_;
+    std::vector<Window> windows_;
+};
+
+// 分配器适配：无参构造时默认初始化而不是值初始化，resize 不再先把整块内存清零，
+// 页面留到读取线程写入时才第一次访问，缺页分散到各线程。Base 可以换成内存池、大页或锁页内存的分配器
+template<typename T, typename Base = std::allocator<T>>
+class PlyUninitializedAllocator : public Base {
+    using Traits = std::allocator_traits<Base>;
+
+public:
+    template<typename U>
+    struct rebind {
+        using other = PlyUninitializedAllocator<U, typename Traits::template rebind_alloc<U>>;
+    };
+
+    PlyUninitializedAllocator() = default;
+    PlyUninitializedAllocator(const Base& base) : Base(base) {}
+    template<typename U, typename OtherBase>
+    PlyUninitializedAllocator(const PlyUninitializedAllocator<U, OtherBase>& other) : Base(static_cast<const OtherBase&>(other)) {}
+
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        Traits::construct(static_cast<Base&>(*this), p, std::forward<Args>(args)...);
+    }
+};
+
+// 读取目标用的不清零数组
+template<typename T>
+using PlyUninitializedVector = std::vector<T, PlyUninitializedAllocator<T>>;
+
+// 文件顶点布局到结构体布局（写入时反过来）的转换计划，每个文件头部只编译一次
+// 按名称匹配字段；类型不同则转换，目标有而源没有的字段置零，源多出的属性跳过
+// 字节序与系统不同时，整块翻转字节序后再转换
+class ConversionPlan {
+public:
+    template<typename VertexType>
+    static ConversionPlan compile(const PlyHeader& header) {
+        if constexpr (PlySchema<VertexType>::isPacked) {
+            // 无填充的结构体与头部一致时直接整体拷贝，不再逐字段匹配
+            if (matchesSchema<VertexType>(header.properties)) {
+                return identity(header.properties, sizeof(VertexType), header.littleEndian != isLittleEndian());
+            }
+        }
+        return compile(header, vertexLayout<VertexType>(), sizeof(VertexType));
+    }
+
+    // 两边布局相同（每条记录 stride 字节）的整体拷贝，swap 时按 layout 翻转字节序
+    static ConversionPlan identity(const std::vector<PlyProperty>& layout, size_t stride, bool swap) {
+        ConversionPlan plan;
+        plan.srcStride_ = plan.dstStride_ = stride;
+        plan.identity_ = true;
+        plan.steps_.push_back(Step{0, 0, stride, PropertyType::UCHAR, PropertyType::UCHAR});
+        if (swap) plan.outSwapper_ = EndianSwapper::forLayout(layout, stride);
+        return plan;
+    }
+
+    // 目标为任意记录布局 layout（每条记录 dstStride 字节），例如结构体或单独的一列
+    static ConversionPlan compile(const PlyHeader& header, const std::vector<PlyProperty>& layout, size_t dstStride) {
+        return compile(header.properties, header.vertexSize(), header.littleEndian, layout, dstStride, isLittleEndian());
+    }
+
+    // 通用形式：源布局到目标布局，两边各自的字节序；写文件时源为结构体、目标为文件
+    static ConversionPlan compile(const std::vector<PlyProperty>& srcLayout, size_t srcStride, bool srcLittleEndian,
+                                  const std::vector<PlyProperty>& dstLayout, size_t dstStride, bool dstLittleEndian) {
+        ConversionPlan plan;
+        plan.srcStride_ = srcStride;
+        plan.dstStride_ = dstStride;
+
+        for (const auto& property : srcLayout) {
+            if (property.size == 0) {
+                throw std::runtime_error("Unsupported property type for: " + property.name);
+            }
+        }
+
+        for (const auto& field : dstLayout) {
+            auto found = std::find_if(srcLayout.begin(), srcLayout.end(),
+                                      [&](const PlyProperty& property) { return property.name == field.name; });
+            if (found == srcLayout.end()) {
+                plan.zeroFill_.emplace_back(field.offset, field.size);
+            } else {
+                plan.addStep(Step{found->offset, field.offset, field.size, found->type, field.type});
+            }
+        }
+
+        plan.identity_ = plan.zeroFill_.empty() && plan.steps_.size() == 1 &&
+                         plan.steps_[0].srcType == plan.steps_[0].dstType &&
+                         plan.steps_[0].srcOffset == 0 && plan.steps_[0].dstOffset == 0 &&
+                         plan.steps_[0].size == plan.srcStride_ && plan.srcStride_ == plan.dstStride_;
+
+        // 布局一致时拷贝后按目标布局翻转一次；否则转换前把源翻转为系统字节序，转换后再翻转为目标字节序
+        if (plan.identity_) {
+            if (srcLittleEndian != dstLittleEndian) plan.outSwapper_ = EndianSwapper::forLayout(dstLayout, dstStride);
+        } else {
+            if (srcLittleEndian != isLittleEndian()) plan.inSwapper_ = EndianSwapper::forLayout(srcLayout, srcStride);
+            if (dstLittleEndian != isLittleEndian()) plan.outSwapper_ = EndianSwapper::forLayout(dstLayout, dstStride);
+        }
+        return plan;
+    }
+
+    // 文件与结构体布局完全一致，可以整体 memcpy（之后可能仍需翻转字节序）
+    bool isIdentity() const { return identity_; }
+    // 需要翻转字节序
+    bool needsSwap() const { return !inSwapper_.empty() || !outSwapper_.empty(); }
+    // 每条文件记录中实际用到的字节数
+    size_t sourceBytes() const {
+        size_t bytes = 0;
+        for (const auto& step : steps_) {
+            bytes += step.srcType == step.dstType ? step.size : propertyTypeSize(step.srcType);
+        }
+        return bytes;
+    }
+    // 只用到记录中的少部分字节（投影读取），适合直接从映射内存按跨步取字段
+    bool isSparse() const { return !identity_ && sourceBytes() * 2 <= srcStride_; }
+    size_t srcStride() const { return srcStride_; }
+    size_t dstStride() const { return dstStride_; }
+
+    // 布局一致的计划：对已整体拷贝到目标的数据原地翻转字节序
+    void swapInPlace(char* data, size_t count) const {
+        outSwapper_.apply(data, count);
+    }
+
+    // 把 count 条源记录 src 转换为目标记录 dst
+    void apply(const char* src, size_t count, char* dst) const {
+        if (identity_) {
+            std::memcpy(dst, src, count * srcStride_);
+            swapInPlace(dst, count);
+            return;
+        }
+
+        if (inSwapper_.empty()) {
+            convert(src, count, dst);
+            outSwapper_.apply(dst, count);
+            return;
+        }
+        PlyUninitializedVector<char> scratch(std::min(count, kTile) * srcStride_);
+        for (size_t first = 0; first < count; first += kTile) {
+            const size_t n = std::min(kTile, count - first);
+            std::memcpy(scratch.data(), src + first * srcStride_, n * srcStride_);
+            inSwapper_.apply(scratch.data(), n);
+            convert(scratch.data(), n, dst + first * dstStride_);
+            outSwapper_.apply(dst + first * dstStride_, n);
+        }
+    }
+
+    // 只做布局和类型转换，两边都是系统字节序
+    void convert(const char* src, size_t count, char* dst) const {
+        // 分成小块逐列处理，让每列的访问都落在缓存内
+        for (size_t first = 0; first < count; first += kTile) {
+            const size_t n = std::min(kTile, count - first);
+            const char* s = src + first * srcStride_;
+            char* d = dst + first * dstStride_;
+            for (const auto& step : steps_) {
+                if (step.srcType == step.dstType) {
+                    copyColumn(s + step.srcOffset, srcStride_, d + step.dstOffset, dstStride_, step.size, n);
+                    continue;
+                }
+                dispatchPropertyType(step.srcType, [&](auto srcValue) {
+                    dispatchPropertyType(step.dstType, [&](auto dstValue) {
+                        convertColumn<decltype(srcValue), decltype(dstValue)>(
+                            s + step.srcOffset, srcStride_, d + step.dstOffset, dstStride_, n);
+                    });
+                });
+            }
+            for (const auto& field : zeroFill_) {
+                for (size_t i = 0; i < n; i++) {
+                    std::memset(d + i * dstStride_ + field.first, 0, field.second);
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t kTile = 4096;
+
+    struct Step {
+        size_t srcOffset;
+        size_t dstOffset;
+        size_t size;  // 目标字段大小；同类型拷贝时为连续字节数
+        PropertyType srcType;
+        PropertyType dstType;
+    };
+
+    // 同类型且在文件和结构体中都相邻的字段合并为一次拷贝
+    void addStep(const Step& step) {
+        if (!steps_.empty()) {
+            Step& last = steps_.back();
+            if (last.srcType == last.dstType && step.srcType == step.dstType &&
+                last.srcOffset + last.size == step.srcOffset && last.dstOffset + last.size == step.dstOffset) {
+                last.size += step.size;
+                last.srcType = last.dstType = PropertyType::UCHAR;
+                return;
+            }
+        }
+        steps_.push_back(step);
+    }
+
+    std::vector<Step> steps_;
+    std::vector<std::pair<size_t, size_t>> zeroFill_;  // (偏移, 大小)
+    size_t srcStride_ = 0;
+    size_t dstStride_ = 0;
+    bool identity_ = false;
+    EndianSwapper inSwapper_;   // 转换前翻转源记录
+    EndianSwapper outSwapper_;  // 转换后翻转目标记录
+};
+
+// 列式（SoA）顶点数据：每个属性一列连续数组
+class PlyColumns {
+public:
+    struct Column {
+        PlyProperty property;  // 名称、类型、元素大小
+        std::vector<char> data;
+    };
+
+    PlyColumns() = default;
+
+    // 按结构体 getMembers() 为每个成员建立一列
+    template<typename VertexType>
+    static PlyColumns forVertex() {
+        PlyColumns columns;
+        for (const auto& member : vertexLayout<VertexType>()) {
+            columns.addColumn(member.name, member.type);
+        }
+        return columns;
+    }
+
+    void addColumn(const std::string& name, PropertyType type) {
+        if (find(name)) {
+            throw std::invalid_argument("Duplicate column: " + name);
+        }
+        const size_t size = propertyTypeSize(type);
+        if (size == 0) {
+            throw std::invalid_argument("Unsupported column type: " + name);
+        }
+        columns_.push_back(Column{PlyProperty{name, type, size, 0}, std::vector<char>(rows_ * size)});
+    }
+
+    void resize(size_t rows) {
+        rows_ = rows;
+        for (auto& column : columns_) column.data.resize(rows * column.property.size);
+    }
+
+    size_t rows() const { return rows_; }
+    std::vector<Column>& columns() { return columns_; }
+    const std::vector<Column>& columns() const { return columns_; }
+
+    Column* find(const std::string& name) {
+        for (auto& column : columns_) {
+            if (column.property.name == name) return &column;
+        }
+        return nullptr;
+    }
+    const Column* find(const std::string& name) const {
+        return const_cast<PlyColumns*>(this)->find(name);
+    }
+
+    // 按名称取某一列的类型化指针，类型必须与列类型一致
+    template<typename T>
+    T* column(const std::string& name) {
+        return const_cast<T*>(static_cast<const PlyColumns*>(this)->column<T>(name));
+    }
+    template<typename T>
+    const T* column(const std::string& name) const {
+        const Column* found = find(name);
+        if (!found) {
+            throw std::out_of_range("No such column: " + name);
+        }
+        if (found->property.type != TypeInfo<T>::getType()) {
+            throw std::invalid_argument("Column type mismatch: " + name);
+        }
+        return reinterpret_cast<const T*>(found->data.data());
+    }
+
+    // 列在一条交错记录中的布局（按列顺序紧密排列）
+    std::vector<PlyProperty> recordLayout() const {
+        std::vector<PlyProperty> layout;
+        for (const auto& column : columns_) layout.push_back(column.property);
+        return packedLayout(layout);
+    }
+
+private:
+    std::vector<Column> columns_;
+    size_t rows_ = 0;
+};
+
+// CSR 形式的面片索引：第 i 个面的顶点索引为 indices[offsets[i], offsets[i + 1])
+struct PlyFaceList {
+    std::vector<uint64_t> offsets;  // 面数 + 1 个
+    std::vector<uint32_t> indices;
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+// 点云数据的统计：点数、包围盒（只含坐标全部有限的点）、坐标含 NaN/Inf 的点数，以及按需设置的属性直方图
+// 读写时在数据还在缓存里时顺带计算，见 PlyStatsCollector
+struct PlyCloudStats {
+    struct Histogram {
+        std::string property;
+        double min = 0;
+        double max = 0;
+        std::vector<uint64_t> bins;
+        uint64_t outside = 0;  // 超出 [min, max] 或不是有限值
+    };
+
+    uint64_t count = 0;
+    uint64_t nonFinite = 0;
+    PlyBounds bounds;
+    std::vector<Histogram> histograms;
+
+    // 在读写之前设置需要的直方图，[min, max] 均分为 bins 格
+    void addHistogram(const std::string& property, double min, double max, size_t bins) {
+        if (!(max > min) || bins == 0) {
+            throw std::invalid_argument("Invalid histogram range for property: " + property);
+        }
+        histograms.push_back(Histogram{property, min, max, std::vector<uint64_t>(bins, 0), 0});
+    }
+
+    // 清零统计结果，保留直方图设置
+    void clear() {
+        count = 0;
+        nonFinite = 0;
+        bounds = PlyBounds();
+        for (auto& histogram : histograms) {
+            std::fill(histogram.bins.begin(), histogram.bins.end(), 0);
+            histogram.outside = 0;
+        }
+    }
+
+    // 合并直方图设置相同的另一份统计
+    void merge(const PlyCloudStats& other) {
+        count += other.count;
+        nonFinite += other.nonFinite;
+        bounds.expand(other.bounds);
+        for (size_t h = 0; h < histograms.size(); h++) {
+            for (size_t b = 0; b < histograms[h].bins.size(); b++) histograms[h].bins[b] += other.histograms[h].bins[b];
+            histograms[h].outside += other.histograms[h].outside;
+        }
+    }
+};
+
+// 三列坐标的包围盒累加到 bounds，返回坐标不全是有限值的点数
+// 有 AVX2 时 8 个一组求最小最大值并检查有限性，出现非有限值时整块改为逐点处理
+inline size_t expandBounds(const float* x, const float* y, const float* z, size_t count, PlyBounds& bounds) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (count >= 8) {
+        const float* axes[3] = {x, y, z};
+        __m256 lo[3], hi[3];
+        __m256 bad = _mm256_setzero_ps();
+        for (int a = 0; a < 3; a++) {
+            lo[a] = _mm256_set1_ps(bounds.min[a]);
+            hi[a] = _mm256_set1_ps(bounds.max[a]);
+        }
+        for (; i + 8 <= count; i += 8) {
+            for (int a = 0; a < 3; a++) {
+                const __m256 v = _mm256_loadu_ps(axes[a] + i);
+                // v - v 对 NaN 和 Inf 都得到 NaN
+                bad = _mm256_or_ps(bad, _mm256_cmp_ps(_mm256_sub_ps(v, v), _mm256_setzero_ps(), _CMP_NEQ_UQ));
+                lo[a] = _mm256_min_ps(lo[a], v);
+                hi[a] = _mm256_max_ps(hi[a], v);
+            }
+        }
+        if (_mm256_movemask_ps(bad) != 0) {
+            i = 0;
+        } else {
+            for (int a = 0; a < 3; a++) {
+                alignas(32) float low[8], high[8];
+                _mm256_store_ps(low, lo[a]);
+                _mm256_store_ps(high, hi[a]);
+                for (int k = 0; k < 8; k++) {
+                    bounds.min[a] = std::min(bounds.min[a], low[k]);
+                    bounds.max[a] = std::max(bounds.max[a], high[k]);
+                }
+            }
+        }
+    }
+#endif
+    size_t nonFinite = 0;
+    for (; i < count; i++) {
+        if (!std::isfinite(x[i]) || !std::isfinite(y[i]) || !std::isfinite(z[i])) {
+            nonFinite++;
+            continue;
+        }
+        bounds.expand(PlyPosition{x[i], y[i], z[i]});
+    }
+    return nonFinite;
+}
+
+// 按记录布局统计一批记录，合并到 target；可以被多个线程同时调用
+// 每块先把 xyz 和直方图属性转成列（字节序不同时先整块翻转），再在列上求包围盒和直方图
+class PlyStatsCollector {
+public:
+    static constexpr size_t kTile = 1024;
+
+    // 构造时清零 target 中的结果；直方图属性在布局中不存在时抛出异常
+    PlyStatsCollector(const std::vector<PlyProperty>& layout, size_t stride, bool littleEndian, PlyCloudStats& target)
+        : target_(target), stride_(stride) {
+        target_.clear();
+        empty_.histograms = target_.histograms;
+        if (littleEndian != isLittleEndian()) swapper_ = EndianSwapper::forLayout(layout, stride);
+        auto has = [&](const std::string& name) {
+            return std::any_of(layout.begin(), layout.end(), [&](const PlyProperty& property) { return property.name == name; });
+        };
+        hasPositions_ = has("x") && has("y") && has("z");
+        if (hasPositions_) {
+            for (const char* axis : {"x", "y", "z"}) {
+                axes_.push_back(ConversionPlan::compile(layout, stride, isLittleEndian(),
+                                                        {PlyProperty{axis, PropertyType::FLOAT, sizeof(float), 0}},
+                                                        sizeof(float), isLittleEndian()));
+            }
+        }
+        for (const auto& histogram : target_.histograms) {
+            if (!has(histogram.property)) {
+                throw std::invalid_argument("No such property for histogram: " + histogram.property);
+            }
+            histograms_.push_back(ConversionPlan::compile(layout, stride, isLittleEndian(),
+                                                          {PlyProperty{histogram.property, PropertyType::DOUBLE, sizeof(double), 0}},
+                                                          sizeof(double), isLittleEndian()));
+        }
+    }
+
+    void add(const char* records, size_t count) const {
+        PlyCloudStats local = empty_;
+        local.count = count;
+        PlyUninitializedVector<char> swapped(swapper_.empty() ? 0 : std::min(count, kTile) * stride_);
+        PlyUninitializedVector<float> columns(3 * kTile);
+        PlyUninitializedVector<double> values(kTile);
+        for (size_t first = 0; first < count; first += kTile) {
+            const size_t n = std::min(kTile, count - first);
+            const char* tile = records + first * stride_;
+            if (!swapper_.empty()) {
+                std::memcpy(swapped.data(), tile, n * stride_);
+                swapper_.apply(swapped.data(), n);
+                tile = swapped.data();
+            }
+            if (hasPositions_) {
+                for (size_t a = 0; a < 3; a++) axes_[a].convert(tile, n, reinterpret_cast<char*>(columns.data() + a * kTile));
+                local.nonFinite += expandBounds(columns.data(), columns.data() + kTile, columns.data() + 2 * kTile, n, local.bounds);
+            }
+            for (size_t h = 0; h < histograms_.size(); h++) {
+                histograms_[h].convert(tile, n, reinterpret_cast<char*>(values.data()));
+                auto& histogram = local.histograms[h];
+                const size_t bins = histogram.bins.size();
+                const double scale = bins / (histogram.max - histogram.min);
+                for (size_t i = 0; i < n; i++) {
+                    const double value = values[i];
+                    if (!(value >= histogram.min && value <= histogram.max)) {
+                        histogram.outside++;
+                        continue;
+                    }
+                    histogram.bins[std::min(bins - 1, static_cast<size_t>((value - histogram.min) * scale))]++;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        target_.merge(local);
+    }
+
+private:
+    PlyCloudStats& target_;
+    PlyCloudStats empty_;
+    size_t stride_;
+    EndianSwapper swapper_;
+    bool hasPositions_ = false;
+    std::vector<ConversionPlan> axes_;
+    std::vector<ConversionPlan> histograms_;
+    mutable std::mutex mutex_;
+};
+
+// 读写统计：默认不收集，把指针交给 PlyReader / PlyOutputFile / PlyBinaryIO（或 PlyWriteOptions::stats）后
+// 累加字节数、系统调用次数和各阶段的墙钟与 CPU 时间。每个线程累加到自己的一项，读写结束后再查询
+// 阶段互不重叠；多线程阶段的时间是各线程之和
+class PlyIOStats {
+public:
+    enum Phase { kHeader, kIO, kConvert, kAllocate, kWait, kPhaseCount };
+
+    struct Time {
+        double wall = 0;  // 秒
+        double cpu = 0;   // 线程 CPU 秒
+    };
+
+    struct Counters {
+        uint64_t bytesRead = 0;     // pread 读入
+        uint64_t bytesMapped = 0;   // 经内存映射访问
+        uint64_t bytesWritten = 0;  // pwrite 写出
+        uint64_t readCalls = 0;
+        uint64_t writeCalls = 0;
+        uint64_t otherCalls = 0;    // open、mmap、ftruncate、close 等
+        std::array<Time, kPhaseCount> phases{};
+
+        uint64_t syscalls() const { return readCalls + writeCalls + otherCalls; }
+
+        Counters& operator+=(const Counters& other) {
+            bytesRead += other.bytesRead, bytesMapped += other.bytesMapped, bytesWritten += other.bytesWritten;
+            readCalls += other.readCalls, writeCalls += other.writeCalls, otherCalls += other.otherCalls;
+            for (size_t i = 0; i < kPhaseCount; i++) {
+                phases[i].wall += other.phases[i].wall;
+                phases[i].cpu += other.phases[i].cpu;
+            }
+            return *this;
+        }
+    };
+
+    struct ThreadCounters {
+        std::thread::id thread;
+        Counters counters;
+    };
+
+    PlyIOStats() = default;
+    PlyIOStats(const PlyIOStats&) = delete;
+    PlyIOStats& operator=(const PlyIOStats&) = delete;
+
+    void addRead(uint64_t bytes, uint64_t calls) {
+        Slot& slot = local();
+        add(slot.bytesRead, bytes);
+        add(slot.readCalls, calls);
+    }
+    void addWrite(uint64_t bytes, uint64_t calls) {
+        Slot& slot = local();
+        add(slot.bytesWritten, bytes);
+        add(slot.writeCalls, calls);
+    }
+    void addMapped(uint64_t bytes) { add(local().bytesMapped, bytes); }
+    void addCalls(uint64_t calls) { add(local().otherCalls, calls); }
+    void addTime(Phase phase, double wall, double cpu) {
+        Slot& slot = local();
+        add(slot.wall[phase], wall);
+        add(slot.cpu[phase], cpu);
+    }
+
+    // 所有线程之和；读写进行中也可以查询，得到的是某一时刻附近的值
+    Counters total() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Counters sum;
+        for (const auto& slot : slots_) sum += slot.snapshot();
+        return sum;
+    }
+
+    // 每个参与过的线程一项
+    std::vector<ThreadCounters> threads() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<ThreadCounters> result;
+        for (const auto& slot : slots_) result.push_back({slot.thread, slot.snapshot()});
+        return result;
+    }
+
+    // 清零；各线程的项保留（线程缓存了它的地址），应在没有读写进行时调用
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& slot : slots_) slot.clear();
+    }
+
+    static const char* phaseName(Phase phase) {
+        static const char* const names[kPhaseCount] = {"header", "io", "convert", "allocate", "wait"};
+        return names[phase];
+    }
+
+    // 可读的汇总，perThread 时再逐线程列出
+    void print(std::ostream& out, bool perThread = false) const {
+        auto printCounters = [&](const char* label, const Counters& counters) {
+            out << label << ": read " << counters.bytesRead << " B in " << counters.readCalls << " calls, mapped "
+                << counters.bytesMapped << " B, written " << counters.bytesWritten << " B in " << counters.writeCalls
+                << " calls, " << counters.syscalls() << " syscalls\n";
+            for (size_t i = 0; i < kPhaseCount; i++) {
+                out << "  " << phaseName(static_cast<Phase>(i)) << ": wall " << counters.phases[i].wall << " s, cpu "
+                    << counters.phases[i].cpu << " s\n";
+            }
+        };
+        printCounters("total", total());
+        if (!perThread) return;
+        const std::vector<ThreadCounters> entries = threads();
+        for (size_t i = 0; i < entries.size(); i++) {
+            printCounters(("thread " + std::to_string(i)).c_str(), entries[i].counters);
+        }
+    }
+
+    static double wallSeconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static double cpuSeconds() {
+        timespec ts;
+        if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+private:
+    // 一个线程的计数：只有这个线程写入，查询时其他线程并发读取，所以用 relaxed 原子的读和写，不需要加锁或读-改-写指令
+    struct Slot {
+        explicit Slot(std::thread::id id) : thread(id) {}
+
+        std::thread::id thread;
+        std::atomic<uint64_t> bytesRead{0}, bytesMapped{0}, bytesWritten{0};
+        std::atomic<uint64_t> readCalls{0}, writeCalls{0}, otherCalls{0};
+        std::array<std::atomic<double>, kPhaseCount> wall{}, cpu{};
+
+        Counters snapshot() const {
+            Counters counters;
+            counters.bytesRead = bytesRead.load(std::memory_order_relaxed);
+            counters.bytesMapped = bytesMapped.load(std::memory_order_relaxed);
+            counters.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+            counters.readCalls = readCalls.load(std::memory_order_relaxed);
+            counters.writeCalls = writeCalls.load(std::memory_order_relaxed);
+            counters.otherCalls = otherCalls.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < kPhaseCount; i++) {
+                counters.phases[i].wall = wall[i].load(std::memory_order_relaxed);
+                counters.phases[i].cpu = cpu[i].load(std::memory_order_relaxed);
+            }
+            return counters;
+        }
+
+        void clear() {
+            for (auto* value : {&bytesRead, &bytesMapped, &bytesWritten, &readCalls, &writeCalls, &otherCalls}) {
+                value->store(0, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < kPhaseCount; i++) {
+                wall[i].store(0, std::memory_order_relaxed);
+                cpu[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    template<typename T>
+    static void add(std::atomic<T>& value, T delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    // 每个实例一个不重复的编号（从 1 开始），线程缓存以它为键，实例销毁后地址被复用也不会误用旧的缓存
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> next(1);
+        return next++;
+    }
+
+    // 当前线程的一项：先查线程缓存，不命中时加锁查找或登记；deque 追加不会使已有项的引用失效
+    Slot& local() {
+        struct Cache {
+            uint64_t owner = 0;
+            Slot* slot = nullptr;
+        };
+        thread_local Cache cache;
+        if (cache.owner == id_) return *cache.slot;
+        const std::thread::id thread = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot* slot = nullptr;
+        for (auto& entry : slots_) {
+            if (entry.thread == thread) slot = &entry;
+        }
+        if (!slot) slot = &slots_.emplace_back(thread);
+        cache = Cache{id_, slot};
+        return *slot;
+    }
+
+    const uint64_t id_ = nextId();
+    mutable std::mutex mutex_;
+    std::deque<Slot> slots_;
+};
+
+// 计时范围：析构时把经过的时间计入当前线程的 phase；stats 为空时什么都不做
+class PlyStatsScope {
+public:
+    PlyStatsScope(PlyIOStats* stats, PlyIOStats::Phase phase) : stats_(stats), phase_(phase) {
+        if (stats_) {
+            wall_ = PlyIOStats::wallSeconds();
+            cpu_ = PlyIOStats::cpuSeconds();
+        }
+    }
+    ~PlyStatsScope() {
+        if (stats_) stats_->addTime(phase_, PlyIOStats::wallSeconds() - wall_, PlyIOStats::cpuSeconds() - cpu_);
+    }
+    PlyStatsScope(const PlyStatsScope&) = delete;
+    PlyStatsScope& operator=(const PlyStatsScope&) = delete;
+
+private:
+    PlyIOStats* stats_;
+    PlyIOStats::Phase phase_;
+    double wall_ = 0;
+    double cpu_ = 0;
+};
+
+// 把 [0, count) 分给多个线程执行 func(begin, end, threadIndex)，threads 为 0 时使用全部硬件线程
+// 任一线程抛出的异常会在所有线程结束后重新抛出
+template<typename Func>
+void parallelFor(size_t count, Func&& func, size_t threads = 0) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, count));
+    if (threads == 1) {
+        if (count > 0) func(size_t(0), count, size_t(0));
+        return;
+    }
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(threads);
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                func(count * t / threads, count * (t + 1) / threads, t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+// 动态分配：各线程从共享计数器依次领取下一个下标执行 func(index, threadIndex)，
+// 适合耗时相差很大的任务（例如大小悬殊的文件）；任一任务抛出异常后其余线程不再领取新任务
+template<typename Func>
+void parallelForDynamic(size_t count, Func&& func, size_t threads = 0) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<size_t>(1, std::min(threads, count));
+    std::atomic<size_t> next(0);
+    parallelFor(threads, [&](size_t, size_t, size_t t) {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                func(i, t);
+            } catch (...) {
+                next = count;
+                throw;
+            }
+        }
+    }, threads);
+}
+
+// 只读内存映射文件
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename, PlyIOStats* stats = nullptr) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file for reading: " + filename);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + filename);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* ptr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Failed to map file: " + filename);
+            }
+            data_ = static_cast<const char*>(ptr);
+            ::madvise(ptr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        // open、fstat、close，非空文件另有 mmap、madvise
+        if (stats) stats->addCalls(size_ > 0 ? 5 : 3);
+    }
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// PLY 文件旁边的空间索引文件（见 PlyChunkIndex）
+inline std::string plyIndexSidecarPath(const std::string& filename) { return filename + ".idx"; }
+
+// 可按位置并发写入的输出文件
+class PlyOutputFile {
+public:
+    // 截断后旧的 .idx 索引不再对应文件内容，一并删除；需要索引的写入在写完后重新保存
+    explicit PlyOutputFile(const std::string& filename, PlyIOStats* stats = nullptr) : filename_(filename), stats_(stats) {
+        fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to open file for writing: " + filename_);
+        }
+        ::unlink(plyIndexSidecarPath(filename_).c_str());
+        if (stats_) stats_->addCalls(2);
+    }
+    ~PlyOutputFile() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    PlyOutputFile(const PlyOutputFile&) = delete;
+    PlyOutputFile& operator=(const PlyOutputFile&) = delete;
+
+    // 把文件预分配到最终长度，之后各线程写入互不重叠的区间
+    void preallocate(size_t size) {
+        if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Failed to resize file: " + filename_);
+        }
+#ifdef __linux__
+        // 尽量真正分配磁盘块，不支持的文件系统上保持稀疏文件即可
+        ::posix_fallocate(fd_, 0, static_cast<off_t>(size));
+        if (stats_) stats_->addCalls(1);
+#endif
+        if (stats_) stats_->addCalls(1);
+    }
+
+    // pwrite 直到写完
+    void writeAt(const char* data, size_t size, size_t offset) const {
+        PlyStatsScope scope(stats_, PlyIOStats::kIO);
+        size_t done = 0, calls = 0;
+        while (done < size) {
+            const ssize_t wrote = ::pwrite(fd_, data + done, size - done, static_cast<off_t>(offset + done));
+            calls++;
+            if (wrote < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Failed to write file: " + filename_);
+            }
+            done += static_cast<size_t>(wrote);
+        }
+        if (stats_) stats_->addWrite(done, calls);
+    }
+
+    void close() {
+        const int fd = fd_;
+        fd_ = -1;
+        if (stats_) stats_->addCalls(1);
+        if (::close(fd) != 0) {
+            throw std::runtime_error("Failed to close file: " + filename_);
+        }
+    }
+
+    int fd() const { return fd_; }
+    PlyIOStats* stats() const { return stats_; }
+
+private:
+    std::string filename_;
+    PlyIOStats* stats_ = nullptr;
+    int fd_ = -1;
+};
+
+// 顶点数据的只读视图，零拷贝时直接指向映射内存
+template<typename VertexType>
+class PlyVertexView {
+public:
+    PlyVertexView() = default;
+    PlyVertexView(std::shared_ptr<const void> storage, const VertexType* data, size_t size)
+        : storage_(std::move(storage)), data_(data), size_(size) {}
+
+    const VertexType* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const VertexType* begin() const { return data_; }
+    const VertexType* end() const { return data_ + size_; }
+    const VertexType& operator[](size_t i) const { return data_[i]; }
+
+    // 拷贝为 vector，对平凡类型是一次整体 memmove
+    std::vector<VertexType> toVector() const {
+        return std::vector<VertexType>(begin(), end());
+    }
+
+private:
+    std::shared_ptr<const void> storage_;  // 保持映射存活
+    const VertexType* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 64 位整数混合（splitmix64 的终结步骤），用于哈希和按序号确定的随机数
+inline uint64_t mixBits(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// 读取时降采样的方式
+struct PlyDecimation {
+    enum Mode { kStride, kRandom, kVoxel };
+
+    Mode mode = kStride;
+    size_t step = 1;        // kStride：每 step 个点保留第一个
+    double fraction = 1;    // kRandom：每个点以此概率保留，只由 seed 和点的序号决定，与线程数无关
+    uint64_t seed = 0;
+    double voxelSize = 0;   // kVoxel：体素边长，每个非空体素输出一个点，各字段为体素内的平均值
+
+    static PlyDecimation everyNth(size_t step) {
+        PlyDecimation decimation;
+        decimation.step = std::max<size_t>(1, step);
+        return decimation;
+    }
+
+    static PlyDecimation random(double fraction, uint64_t seed = 0) {
+        PlyDecimation decimation;
+        decimation.mode = kRandom;
+        decimation.fraction = fraction;
+        decimation.seed = seed;
+        return decimation;
+    }
+
+    static PlyDecimation voxelGrid(double size) {
+        PlyDecimation decimation;
+        decimation.mode = kVoxel;
+        decimation.voxelSize = size;
+        return decimation;
+    }
+
+    // kRandom 下第 index 个点是否保留
+    bool keep(size_t index) const {
+        if (fraction >= 1) return true;
+        if (!(fraction > 0)) return false;
+        return mixBits(seed ^ mixBits(index)) < static_cast<uint64_t>(fraction * 18446744073709551616.0);
+    }
+};
+
+// 并发的体素累加器：每个体素累加 width 个 double 和点数
+// 体素按坐标哈希分到若干分片，每片一把锁；各线程先把一段数据累加到本地的 Batch，再按分片合并，
+// 加锁次数与体素数而不是点数成正比
+class PlyVoxelAccumulator {
+public:
+    using Key = std::array<int64_t, 3>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return static_cast<size_t>(mixBits(mixBits(mixBits(key[0]) ^ key[1]) ^ key[2]));
+        }
+    };
+
+    // 一组体素的累加值，线程本地使用或作为一个分片
+    class Batch {
+    public:
+        explicit Batch(size_t width) : width_(width) {}
+
+        void add(const Key& key, const double* values, uint64_t count = 1) {
+            auto found = slots_.emplace(key, counts_.size());
+            if (found.second) {
+                sums_.insert(sums_.end(), values, values + width_);
+                counts_.push_back(count);
+                return;
+            }
+            double* sum = sums_.data() + found.first->second * width_;
+            for (size_t i = 0; i < width_; i++) sum[i] += values[i];
+            counts_[found.first->second] += count;
+        }
+
+        void clear() {
+            slots_.clear();
+            sums_.clear();
+            counts_.clear();
+        }
+
+    private:
+        friend class PlyVoxelAccumulator;
+        size_t width_;
+        std::unordered_map<Key, size_t, KeyHash> slots_;
+        std::vector<double> sums_;
+        std::vector<uint64_t> counts_;
+    };
+
+    explicit PlyVoxelAccumulator(size_t width, size_t shards = 64) : width_(width) {
+        for (size_t i = 0; i < std::max<size_t>(1, shards); i++) shards_.emplace_back(width);
+    }
+
+    size_t width() const { return width_; }
+
+    // 把 batch 合并进来并清空它
+    void merge(Batch& batch) {
+        std::vector<std::pair<size_t, const std::pair<const Key, size_t>*>> entries;
+        entries.reserve(batch.slots_.size());
+        for (const auto& entry : batch.slots_) entries.emplace_back(KeyHash()(entry.first) % shards_.size(), &entry);
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t begin = 0, end = 0; begin < entries.size(); begin = end) {
+            Shard& shard = shards_[entries[begin].first];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (end = begin; end < entries.size() && entries[end].first == entries[begin].first; end++) {
+                const size_t slot = entries[end].second->second;
+                shard.voxels.add(entries[end].second->first, batch.sums_.data() + slot * width_, batch.counts_[slot]);
+            }
+        }
+        batch.clear();
+    }
+
+    // 各体素的平均值，按体素坐标排序，每个体素 width 个 double
+    std::vector<double> averages() const {
+        struct Voxel {
+            Key key;
+            const double* sum;
+            uint64_t count;
+        };
+        std::vector<Voxel> voxels;
+        for (const auto& shard : shards_) {
+            for (const auto& entry : shard.voxels.slots_) {
+                voxels.push_back({entry.first, shard.voxels.sums_.data() + entry.second * width_, shard.voxels.counts_[entry.second]});
+            }
+        }
+        std::sort(voxels.begin(), voxels.end(), [](const Voxel& a, const Voxel& b) { return a.key < b.key; });
+        std::vector<double> result(voxels.size() * width_);
+        for (size_t v = 0; v < voxels.size(); v++) {
+            for (size_t i = 0; i < width_; i++) result[v * width_ + i] = voxels[v].sum[i] / voxels[v].count;
+        }
+        return result;
+    }
+
+private:
+    struct Shard {
+        explicit Shard(size_t width) : voxels(width) {}
+        std::mutex mutex;
+        Batch voxels;
+    };
+
+    size_t width_;
+    std::deque<Shard> shards_;  // Shard 含锁不可移动
+};
+
+template<typename VertexType>
+class PlyBatchReader;
+
+// 只读的 PLY 读取器：构造时解析一次头部，之后不再修改任何状态
+// 所有读取都用 pread 按位置读，同一个实例可以被多个线程同时使用
+class PlyReader {
+public:
+    static constexpr size_t kBlockVertices = 1 << 16;   // 每次转换的顶点块大小
+    static constexpr size_t kReadAheadBytes = 8 << 20;  // 流水线读取时每个缓冲区的大小
+    static constexpr size_t kReadAheadBuffers = 4;      // 流水线读取时解码线程之外多备的缓冲区个数
+
+    // stats 非空时所有读取累加到其中，需比读取器活得久
+    explicit PlyReader(const std::string& filename, PlyIOStats* stats = nullptr) : filename_(filename), stats_(stats) {
+        fd_ = openFile(filename_, stats_);
+        try {
+            header_ = readHeader(fd_, filename_, stats_);
+            initialize(nullptr);
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+    ~PlyReader() { ::close(fd_); }
+    PlyReader(const PlyReader&) = delete;
+    PlyReader& operator=(const PlyReader&) = delete;
+
+    // 只读取并解析头部，不建立映射，也不扫描变长元素（vertex 前有变长元素时其 offset 为 npos）
+    static PlyHeader readHeader(const std::string& filename, PlyIOStats* stats = nullptr) {
+        const int fd = openFile(filename, stats);
+        try {
+            PlyHeader header = readHeader(fd, filename, stats);
+            ::close(fd);
+            if (stats) stats->addCalls(1);
+            return header;
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    const std::string& filename() const { return filename_; }
+    const PlyHeader& header() const { return header_; }
+    size_t vertexCount() const { return header_.vertexCount; }
+    std::shared_ptr<const MappedFile> mapping() const { return mapping_; }
+    PlyIOStats* stats() const { return stats_; }
+
+    // 读取 [first, first + count) 范围内的顶点到 out（至少容纳 count 个）
+    template<typename VertexType>
+    void readRange(size_t first, size_t count, VertexType* out) const {
+        readRange(ConversionPlan::compile<VertexType>(header_), first, count, reinterpret_cast<char*>(out));
+    }
+
+    template<typename VertexType, typename Allocator>
+    void readRange(size_t first, size_t count, std::vector<VertexType, Allocator>& vertices) const {
+        checkRange(first, count);
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(count);
+        }
+        readRange(first, count, vertices.data());
+    }
+
+    // 读取全部顶点，按范围分给 threads 个线程（0 表示全部硬件线程）同时读取
+    // 需要转换（字段匹配、类型转换）时改为流水线：I/O 线程预读，threads 个线程同时转换
+    // 使用 PlyUninitializedAllocator 时 resize 不清零，页面由写入它的线程第一次访问
+    template<typename VertexType, typename Allocator>
+    void read(std::vector<VertexType, Allocator>& vertices, size_t threads = 0) const {
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(vertexCount());
+        }
+        read(vertices.data(), threads);
+    }
+
+    // 读取全部顶点到调用方提供的内存 out（至少容纳 vertexCount() 个，可以未初始化）
+    template<typename VertexType>
+    void read(VertexType* vertices, size_t threads = 0) const {
+        readVertices(vertices, threads, nullptr);
+    }
+
+    // 读取的同时统计包围盒、非有限坐标和 cloudStats 中设置的直方图，各块在转换时顺带计算
+    template<typename VertexType, typename Allocator>
+    void read(std::vector<VertexType, Allocator>& vertices, PlyCloudStats& cloudStats, size_t threads = 0) const {
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(vertexCount());
+        }
+        read(vertices.data(), cloudStats, threads);
+    }
+
+    template<typename VertexType>
+    void read(VertexType* vertices, PlyCloudStats& cloudStats, size_t threads = 0) const {
+        const ConversionPlan plan = ConversionPlan::compile<VertexType>(header_);
+        // 流水线上统计文件字节序的原始记录，其余情况统计已是系统字节序的数据
+        const PlyStatsCollector collector(header_.properties, header_.vertexSize(),
+                                          pipelined(plan) ? header_.littleEndian : isLittleEndian(), cloudStats);
+        readVertices(vertices, threads, &collector);
+    }
+
+    // 流式分批读取：每批最多 batchSize 个顶点，始终复用同一块缓冲区，内存占用与文件大小无关
+    // func(PlyVertexView<VertexType>) 中的视图只在回调期间有效；回调返回 false 时提前结束
+    // 返回已处理的顶点数
+    template<typename VertexType, typename Func>
+    size_t readBatches(size_t batchSize, Func&& func) const {
+        const ConversionPlan plan = ConversionPlan::compile<VertexType>(header_);
+        const size_t total = vertexCount();
+        batchSize = std::max<size_t>(1, std::min(batchSize, total));
+        // 布局一致时直接在预读缓冲区上给出视图，否则转换到 batch
+        const bool direct = plan.isIdentity() && alignof(VertexType) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+        std::vector<VertexType> batch(direct ? 0 : batchSize);
+        size_t done = 0;
+        // 回调在调用线程上按文件顺序执行，同时 I/O 线程预读后面的批次
+        pipeline(batchSize, kReadAheadBuffers, 1, [&](size_t, size_t count, char* raw, size_t) {
+            const VertexType* data = batch.data();
+            {
+                PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                if (direct) {
+                    plan.swapInPlace(raw, count);
+                    data = reinterpret_cast<const VertexType*>(raw);
+                } else {
+                    plan.apply(raw, count, reinterpret_cast<char*>(batch.data()));
+                }
+            }
+            done += count;
+
+            PlyVertexView<VertexType> view(nullptr, data, count);
+            if constexpr (std::is_same_v<decltype(func(view)), bool>) {
+                return func(view);
+            } else {
+                func(view);
+                return true;
+            }
+        });
+        return done;
+    }
+
+    // 读取时降采样，完整分辨率的点云不会放进内存；返回保留的点数
+    // 各段由流水线并行处理：kStride、kRandom 只转换选中的记录，按文件顺序输出；
+    // kVoxel 按段累加到并发的体素累加器，每个非空体素输出一个平均点（整数字段四舍五入），按体素坐标排序
+    template<typename VertexType, typename Allocator>
+    size_t readDecimated(const PlyDecimation& decimation, std::vector<VertexType, Allocator>& vertices, size_t threads = 0) const {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        if (decimation.mode == PlyDecimation::kVoxel) return readVoxels(decimation.voxelSize, vertices, threads);
+
+        const ConversionPlan plan = ConversionPlan::compile<VertexType>(header_);
+        const size_t stride = header_.vertexSize();
+        const size_t segment = std::max<size_t>(1, kReadAheadBytes / stride);
+        const size_t step = std::max<size_t>(1, decimation.step);
+        // 先算出每段保留的点数（抽取按公式，随机按序号哈希，都不读文件），输出一次分配到位，
+        // 各段直接转换到它在 vertices 中的位置
+        const size_t segments = (vertexCount() + segment - 1) / segment;
+        std::vector<size_t> offsets(segments + 1, 0);
+        parallelFor(segments, [&](size_t begin, size_t end, size_t) {
+            for (size_t s = begin; s < end; s++) {
+                const size_t first = s * segment;
+                const size_t last = std::min(first + segment, vertexCount());
+                size_t kept = 0;
+                if (decimation.mode == PlyDecimation::kStride) {
+                    kept = (last + step - 1) / step - (first + step - 1) / step;
+                } else {
+                    for (size_t i = first; i < last; i++) kept += decimation.keep(i) ? 1 : 0;
+                }
+                offsets[s + 1] = kept;
+            }
+        }, threads);
+        for (size_t s = 0; s < segments; s++) offsets[s + 1] += offsets[s];
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(offsets.back());
+        }
+        char* out = reinterpret_cast<char*>(vertices.data());
+        pipeline(segment, threads + kReadAheadBuffers, threads, [&](size_t first, size_t count, char* raw, size_t) {
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            // 选中的记录在缓冲区内前移压紧，只转换这些
+            size_t kept = 0;
+            auto take = [&](size_t i) {
+                if (kept != i) std::memcpy(raw + kept * stride, raw + i * stride, stride);
+                kept++;
+            };
+            if (decimation.mode == PlyDecimation::kStride) {
+                for (size_t i = (step - first % step) % step; i < count; i += step) take(i);
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    if (decimation.keep(first + i)) take(i);
+                }
+            }
+            plan.apply(raw, kept, out + offsets[first / segment] * sizeof(VertexType));
+            return true;
+        });
+        return offsets.back();
+    }
+
+    // 流水线读取全部顶点的原始记录（文件布局和字节序）：一个 I/O 线程按顺序把每段 segmentVertices 个顶点
+    // 读入 buffers 个缓冲区组成的环，consumers 个线程同时处理已读好的段，处理完的缓冲区交还给 I/O 线程继续预读，
+    // 吞吐量接近 max(I/O, 处理) 而不是两者之和
+    // process(first, count, raw, consumer) 可以原地修改 raw，返回 false 时停止；只有一个处理线程时按文件顺序处理
+    template<typename Process>
+    void pipeline(size_t segmentVertices, size_t buffers, size_t consumers, Process&& process) const {
+        const size_t stride = header_.vertexSize();
+        const size_t total = vertexCount();
+        segmentVertices = std::max<size_t>(1, segmentVertices);
+        consumers = std::max<size_t>(1, consumers);
+        buffers = std::max<size_t>(consumers + 1, buffers);
+
+        struct Segment {
+            PlyUninitializedVector<char> data;
+            size_t first = 0;
+            size_t count = 0;
+        };
+        std::vector<Segment> segments(buffers);
+        std::mutex mutex;
+        std::condition_variable filled, freed;
+        std::deque<size_t> ready, idle;
+        for (size_t i = 0; i < buffers; i++) idle.push_back(i);
+        bool finished = false, stopped = false;
+        std::exception_ptr readError;
+
+        std::thread io([&]() {
+            try {
+                for (size_t first = 0; first < total; first += segmentVertices) {
+                    size_t index;
+                    {
+                        // I/O 线程在这里等待说明处理跟不上读取
+                        PlyStatsScope scope(stats_, PlyIOStats::kWait);
+                        std::unique_lock<std::mutex> lock(mutex);
+                        freed.wait(lock, [&] { return stopped || !idle.empty(); });
+                        if (stopped) break;
+                        index = idle.front();
+                        idle.pop_front();
+                    }
+                    Segment& segment = segments[index];
+                    segment.first = first;
+                    segment.count = std::min(segmentVertices, total - first);
+                    if (segment.data.size() < segment.count * stride) {
+                        PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+                        segment.data.resize(segment.count * stride);
+                    }
+                    readExact(segment.data.data(), segment.count * stride, header_.dataOffset + first * stride);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ready.push_back(index);
+                    }
+                    filled.notify_one();
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                readError = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            filled.notify_all();
+        });
+
+        auto stop = [&]() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+            }
+            filled.notify_all();
+            freed.notify_all();
+        };
+        try {
+            parallelFor(consumers, [&](size_t begin, size_t, size_t) {
+                try {
+                    while (true) {
+                        size_t index;
+                        {
+                            // 处理线程在这里等待说明读取跟不上处理
+                            PlyStatsScope scope(stats_, PlyIOStats::kWait);
+                            std::unique_lock<std::mutex> lock(mutex);
+                            filled.wait(lock, [&] { return stopped || finished || !ready.empty(); });
+                            if (stopped || ready.empty()) break;
+                            index = ready.front();
+                            ready.pop_front();
+                        }
+                        Segment& segment = segments[index];
+                        const bool more = process(segment.first, segment.count, segment.data.data(), begin);
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            idle.push_back(index);
+                        }
+                        freed.notify_one();
+                        if (!more) stop();
+                    }
+                } catch (...) {
+                    stop();
+                    throw;
+                }
+            }, consumers);
+        } catch (...) {
+            stop();
+            io.join();
+            throw;
+        }
+        io.join();
+        if (readError) std::rethrow_exception(readError);
+    }
+
+    // 按列读取：对 columns 中已定义的每一列（名称、类型），从文件同名属性解交错并转换，文件没有的列置零
+    void readColumns(PlyColumns& columns, size_t threads = 0) const {
+        std::vector<ConversionPlan> plans;
+        for (const auto& column : columns.columns()) {
+            plans.push_back(ConversionPlan::compile(header_, {column.property}, column.property.size));
+        }
+        const EndianSwapper swapper = header_.littleEndian != isLittleEndian() ? EndianSwapper::forHeader(header_) : EndianSwapper();
+        const size_t count = vertexCount();
+        const size_t stride = header_.vertexSize();
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            columns.resize(count);
+        }
+
+        // 只取少数属性且无需翻转字节序时，直接从映射内存按跨步取字段，不把整条记录拷进缓冲区
+        size_t usedBytes = 0;
+        for (const auto& plan : plans) usedBytes += plan.sourceBytes();
+        const bool direct = swapper.empty() && usedBytes * 2 <= stride;
+
+        const size_t blocks = (count + kBlockVertices - 1) / kBlockVertices;
+        parallelFor(blocks, [&](size_t begin, size_t end, size_t) {
+            PlyUninitializedVector<char> raw(direct ? 0 : kBlockVertices * stride);
+            for (size_t block = begin; block < end; block++) {
+                const size_t first = block * kBlockVertices;
+                const size_t n = std::min(kBlockVertices, count - first);
+                const char* src = direct ? mappedRange(first, n, stride) : raw.data();
+                if (!direct) readExact(raw.data(), n * stride, header_.dataOffset + first * stride);
+                if (direct && stats_) stats_->addMapped(n * stride);
+                PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                if (!direct) swapper.apply(raw.data(), n);
+                for (size_t c = 0; c < plans.size(); c++) {
+                    auto& column = columns.columns()[c];
+                    plans[c].convert(src, n, column.data.data() + first * column.property.size);
+                }
+            }
+        }, threads);
+    }
+
+    // 按结构体成员建立列并读取
+    template<typename VertexType>
+    PlyColumns readColumns(size_t threads = 0) const {
+        PlyColumns columns = PlyColumns::forVertex<VertexType>();
+        readColumns(columns, threads);
+        return columns;
+    }
+
+    // 列投影：只读取 names 中的属性，列类型与文件一致
+    PlyColumns readColumns(const std::vector<std::string>& names, size_t threads = 0) const {
+        PlyColumns columns;
+        for (const auto& name : names) {
+            auto found = std::find_if(header_.properties.begin(), header_.properties.end(),
+                                      [&](const PlyProperty& property) { return property.name == name; });
+            if (found == header_.properties.end()) {
+                throw std::out_of_range("No such property: " + name + " in " + filename_);
+            }
+            columns.addColumn(name, found->type);
+        }
+        readColumns(columns, threads);
+        return columns;
+    }
+
+    // 按计划（源布局为文件顶点布局）读取并转换 [first, first + count) 的顶点；布局一致时直接读入目标内存
+    void readRange(const ConversionPlan& plan, size_t first, size_t count, char* out) const {
+        checkRange(first, count);
+        const size_t offset = header_.dataOffset + first * plan.srcStride();
+        if (plan.isIdentity()) {
+            readExact(out, count * plan.srcStride(), offset);
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            plan.swapInPlace(out, count);
+            return;
+        }
+        if (plan.isSparse() && !plan.needsSwap()) {
+            // 投影读取：只访问用到的字段，记录跨越多页时未用到的页不会被读入
+            if (stats_) stats_->addMapped(count * plan.srcStride());
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            plan.convert(mappedRange(first, count, plan.srcStride()), count, out);
+            return;
+        }
+        PlyUninitializedVector<char> block(std::min(count, kBlockVertices) * plan.srcStride());
+        for (size_t done = 0; done < count; done += kBlockVertices) {
+            const size_t n = std::min(kBlockVertices, count - done);
+            readExact(block.data(), n * plan.srcStride(), offset + done * plan.srcStride());
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            plan.apply(block.data(), n, out + done * plan.dstStride());
+        }
+    }
+
+    // 读取任意定长元素（例如 vertex 之外的 material、edge 等）到结构体数组
+    template<typename ElementType, typename Allocator>
+    void readElement(const std::string& name, std::vector<ElementType, Allocator>& records, size_t threads = 0) const {
+        const size_t index = elementIndex(name);
+        const PlyElement& element = header_.elements[index];
+        if (element.hasList()) {
+            throw std::runtime_error("Element has list properties: " + name);
+        }
+        const size_t stride = element.recordSize();
+        const ConversionPlan plan = ConversionPlan::compile(element.properties, stride, header_.littleEndian,
+                                                            vertexLayout<ElementType>(), sizeof(ElementType), isLittleEndian());
+        const char* src = mappedBytes(elementOffset(index), element.count * stride);
+        if (stats_) stats_->addMapped(element.count * stride);
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            records.resize(element.count);
+        }
+        char* out = reinterpret_cast<char*>(records.data());
+        const size_t blocks = (element.count + kBlockVertices - 1) / kBlockVertices;
+        parallelFor(blocks, [&](size_t begin, size_t end, size_t) {
+            const size_t first = begin * kBlockVertices;
+            const size_t last = std::min(element.count, end * kBlockVertices);
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            plan.apply(src + first * stride, last - first, out + first * sizeof(ElementType));
+        }, threads);
+    }
+
+    // 读取面片的顶点索引列表（CSR 形式）
+    // 第一遍确定每条记录的位置：先假设所有记录等长（如全是三角形）并行验证，不成立时顺序扫描
+    // 第二遍按记录并行解码索引，写入预先算好的位置
+    void readFaces(PlyFaceList& faces, const std::string& elementName = "face",
+                   const std::string& propertyName = std::string(), size_t threads = 0) const {
+        const size_t index = elementIndex(elementName);
+        const PlyElement& element = header_.elements[index];
+        size_t listIndex = element.properties.size();
+        for (size_t i = 0; i < element.properties.size(); i++) {
+            const auto& property = element.properties[i];
+            if (!property.isList) continue;
+            if (propertyName.empty() ? (listIndex == element.properties.size() || property.name == "vertex_indices" ||
+                                        property.name == "vertex_index")
+                                     : property.name == propertyName) {
+                listIndex = i;
+            }
+        }
+        if (listIndex == element.properties.size()) {
+            throw std::out_of_range("No list property " + propertyName + " in element " + elementName + ": " + filename_);
+        }
+
+        const size_t count = element.count;
+        std::vector<uint64_t> records;
+        const size_t dataStart = elementOffset(index);
+        const size_t dataEnd = scanElement(element, dataStart, &records);
+        if (stats_) stats_->addMapped(dataEnd - dataStart);
+
+        // 每个面的索引个数 -> 前缀和得到偏移
+        faces.offsets.assign(count + 1, 0);
+        parallelFor(count, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                faces.offsets[i + 1] = locateList(element, listIndex, i, records[i]).first;
+            }
+        }, threads);
+        for (size_t i = 0; i < count; i++) faces.offsets[i + 1] += faces.offsets[i];
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            faces.indices.resize(faces.offsets[count]);
+        }
+
+        const PlyProperty& list = element.properties[listIndex];
+        const bool swap = header_.littleEndian != isLittleEndian();
+        const char* base = mapping_->data();
+        dispatchPropertyType(list.type, [&](auto item) {
+            using Item = decltype(item);
+            parallelFor(count, [&](size_t begin, size_t end, size_t) {
+                PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                for (size_t i = begin; i < end; i++) {
+                    const size_t items = locateList(element, listIndex, i, records[i]).second;
+                    uint32_t* out = faces.indices.data() + faces.offsets[i];
+                    const size_t n = faces.offsets[i + 1] - faces.offsets[i];
+                    for (size_t k = 0; k < n; k++) {
+                        out[k] = convertValue<uint32_t>(loadValue<Item>(base + items + k * sizeof(Item), swap));
+                    }
+                }
+            }, threads);
+        });
+    }
+
+    // 第 index 个元素数据的起始位置，前面的变长元素需要扫描
+    size_t elementOffset(size_t index) const {
+        const auto& elements = header_.elements;
+        size_t i = index;
+        while (elements[i].offset == PlyElement::npos) i--;
+        size_t offset = elements[i].offset;
+        for (; i < index; i++) offset = scanElement(elements[i], offset, nullptr);
+        return offset;
+    }
+
+private:
+    // 需要转换（字段匹配、类型转换）时走流水线，否则按块直接读入目标内存
+    static bool pipelined(const ConversionPlan& plan) {
+        return !plan.isIdentity() && !(plan.isSparse() && !plan.needsSwap());
+    }
+
+    template<typename VertexType>
+    void readVertices(VertexType* vertices, size_t threads, const PlyStatsCollector* collector) const {
+        const ConversionPlan plan = ConversionPlan::compile<VertexType>(header_);
+        const size_t count = vertexCount();
+        char* out = reinterpret_cast<char*>(vertices);
+        if (pipelined(plan)) {
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+            pipeline(std::max<size_t>(1, kReadAheadBytes / plan.srcStride()), threads + kReadAheadBuffers, threads,
+                     [&](size_t first, size_t n, char* raw, size_t) {
+                         PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                         if (collector) collector->add(raw, n);
+                         plan.apply(raw, n, out + first * sizeof(VertexType));
+                         return true;
+                     });
+            return;
+        }
+        const size_t blocks = (count + kBlockVertices - 1) / kBlockVertices;
+        parallelFor(blocks, [&](size_t begin, size_t end, size_t) {
+            const size_t first = begin * kBlockVertices;
+            const size_t last = std::min(count, end * kBlockVertices);
+            if (!collector) {
+                readRange(plan, first, last - first, out + first * sizeof(VertexType));
+                return;
+            }
+            // 统计时逐块读取，趁数据还在缓存里
+            for (size_t block = first; block < last; block += kBlockVertices) {
+                const size_t n = std::min(kBlockVertices, last - block);
+                readRange(plan, block, n, out + block * sizeof(VertexType));
+                PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                collector->add(plan.isIdentity() ? out + block * sizeof(VertexType) : mappedRange(block, n, plan.srcStride()), n);
+            }
+        }, threads);
+    }
+
+    // 体素降采样：每条记录先按计划转成全部字段为 double 的累加布局（结构体的字段，再补上 xyz），
+    // 本地按体素累加一段后合并；最后取平均并按计划转回结构体
+    template<typename VertexType, typename Allocator>
+    size_t readVoxels(double voxelSize, std::vector<VertexType, Allocator>& vertices, size_t threads) const {
+        if (!(voxelSize > 0)) {
+            throw std::invalid_argument("Voxel size must be positive: " + filename_);
+        }
+        const std::vector<PlyProperty> members = vertexLayout<VertexType>();
+        std::vector<PlyProperty> sums;
+        auto addSum = [&](const std::string& name) {
+            for (const auto& property : sums) {
+                if (property.name == name) return;
+            }
+            sums.push_back(PlyProperty{name, PropertyType::DOUBLE, sizeof(double), 0});
+        };
+        for (const auto& member : members) addSum(member.name);
+        for (const char* axis : {"x", "y", "z"}) {
+            if (std::none_of(header_.properties.begin(), header_.properties.end(),
+                             [&](const PlyProperty& property) { return property.name == axis; })) {
+                throw std::runtime_error("Voxel decimation needs x, y and z properties: " + filename_);
+            }
+            addSum(axis);
+        }
+        sums = packedLayout(sums);
+        const size_t width = sums.size();
+        size_t axes[3];
+        for (size_t i = 0; i < width; i++) {
+            if (sums[i].name == "x") axes[0] = i;
+            if (sums[i].name == "y") axes[1] = i;
+            if (sums[i].name == "z") axes[2] = i;
+        }
+
+        const ConversionPlan toSums = ConversionPlan::compile(header_, sums, width * sizeof(double));
+        const double scale = 1.0 / voxelSize;
+        PlyVoxelAccumulator accumulator(width);
+        const size_t segment = std::max<size_t>(1, kReadAheadBytes / header_.vertexSize());
+        pipeline(segment, threads + kReadAheadBuffers, threads, [&](size_t, size_t count, char* raw, size_t) {
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            PlyUninitializedVector<double> values(std::min(count, kBlockVertices) * width);
+            PlyVoxelAccumulator::Batch batch(width);
+            for (size_t done = 0; done < count; done += kBlockVertices) {
+                const size_t n = std::min(kBlockVertices, count - done);
+                toSums.apply(raw + done * header_.vertexSize(), n, reinterpret_cast<char*>(values.data()));
+                for (size_t i = 0; i < n; i++) {
+                    const double* record = values.data() + i * width;
+                    PlyVoxelAccumulator::Key key;
+                    bool finite = true;
+                    for (size_t axis = 0; axis < 3; axis++) {
+                        const double cell = std::floor(record[axes[axis]] * scale);
+                        finite = finite && std::abs(cell) < 9.0e18;
+                        key[axis] = finite ? static_cast<int64_t>(cell) : 0;
+                    }
+                    if (finite) batch.add(key, record);
+                }
+            }
+            accumulator.merge(batch);
+            return true;
+        });
+
+        std::vector<double> averages = accumulator.averages();
+        const size_t voxels = averages.size() / width;
+        for (size_t i = 0; i < width; i++) {
+            const auto member = std::find_if(members.begin(), members.end(),
+                                             [&](const PlyProperty& property) { return property.name == sums[i].name; });
+            if (member == members.end() || member->type == PropertyType::FLOAT || member->type == PropertyType::DOUBLE) continue;
+            for (size_t v = 0; v < voxels; v++) averages[v * width + i] = std::round(averages[v * width + i]);
+        }
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(voxels);
+        }
+        const ConversionPlan fromSums = ConversionPlan::compile(sums, width * sizeof(double), isLittleEndian(), members,
+                                                                sizeof(VertexType), isLittleEndian());
+        fromSums.apply(reinterpret_cast<const char*>(averages.data()), voxels, reinterpret_cast<char*>(vertices.data()));
+        return voxels;
+    }
+
+    size_t elementIndex(const std::string& name) const {
+        for (size_t i = 0; i < header_.elements.size(); i++) {
+            if (header_.elements[i].name == name) return i;
+        }
+        throw std::out_of_range("No element " + name + " in " + filename_);
+    }
+
+    // 映射内存中 [offset, offset + size) 的地址
+    const char* mappedBytes(size_t offset, size_t size) const {
+        if (offset > mapping_->size() || size > mapping_->size() - offset) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+        return mapping_->data() + offset;
+    }
+
+    template<typename T>
+    static T loadValue(const char* p, bool swap) {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return swap ? swapEndian(value) : value;
+    }
+
+    // 列表长度；有符号的长度类型读到负数时返回 npos
+    size_t loadCount(PropertyType type, const char* p) const {
+        size_t count = 0;
+        const bool swap = header_.littleEndian != isLittleEndian();
+        dispatchPropertyType(type, [&](auto value) {
+            using Count = decltype(value);
+            const Count n = loadValue<Count>(p, swap);
+            if constexpr (std::is_signed_v<Count>) {
+                if (n < 0) {
+                    count = PlyElement::npos;
+                    return;
+                }
+            }
+            count = convertValue<size_t>(n);
+        });
+        return count;
+    }
+
+    // 第 record 条记录的列表长度，负数时报错
+    size_t loadCount(const PlyElement& element, size_t record, const PlyProperty& property, size_t pos) const {
+        const size_t n = loadCount(property.countType, mappedBytes(pos, propertyTypeSize(property.countType)));
+        if (n == PlyElement::npos) {
+            throw std::runtime_error("Negative list count in " + element.name + " " + std::to_string(record) + ": " + filename_);
+        }
+        return n;
+    }
+
+    // 第 record 条记录（从 pos 开始）中第 listIndex 个（列表）属性：返回（元素个数，首个元素在文件中的位置）
+    std::pair<size_t, size_t> locateList(const PlyElement& element, size_t listIndex, size_t record, size_t pos) const {
+        for (size_t i = 0;; i++) {
+            const PlyProperty& property = element.properties[i];
+            if (!property.isList) {
+                pos += property.size;
+                continue;
+            }
+            const size_t countSize = propertyTypeSize(property.countType);
+            const size_t n = loadCount(element, record, property, pos);
+            if (i == listIndex) return {n, pos + countSize};
+            pos += countSize + n * propertyTypeSize(property.type);
+        }
+    }
+
+    // 第 record 条记录（从 pos 开始）的字节数
+    size_t recordSizeAt(const PlyElement& element, size_t record, size_t pos) const {
+        const size_t start = pos;
+        for (const auto& property : element.properties) {
+            if (!property.isList) {
+                pos += property.size;
+                continue;
+            }
+            pos += propertyTypeSize(property.countType) + loadCount(element, record, property, pos) * propertyTypeSize(property.type);
+        }
+        mappedBytes(start, pos - start);
+        return pos - start;
+    }
+
+    // 按等长假设推测的记录位置可能落在记录中间：读到负数长度或越界时返回 npos 而不报错
+    size_t guessRecordSizeAt(const PlyElement& element, size_t pos) const {
+        const size_t start = pos;
+        for (const auto& property : element.properties) {
+            if (!property.isList) {
+                pos += property.size;
+                continue;
+            }
+            const size_t countSize = propertyTypeSize(property.countType);
+            if (pos > mapping_->size() || countSize > mapping_->size() - pos) return PlyElement::npos;
+            const size_t n = loadCount(property.countType, mapping_->data() + pos);
+            if (n == PlyElement::npos || n > (mapping_->size() - pos) / std::max<size_t>(1, propertyTypeSize(property.type))) {
+                return PlyElement::npos;
+            }
+            pos += countSize + n * propertyTypeSize(property.type);
+        }
+        return pos <= mapping_->size() ? pos - start : PlyElement::npos;
+    }
+
+    // 扫描一个元素的数据，返回其结束位置；records 非空时记录每条记录的起始位置
+    size_t scanElement(const PlyElement& element, size_t offset, std::vector<uint64_t>* records) const {
+        const size_t count = element.count;
+        if (records) records->resize(count);
+        if (count == 0) return offset;
+
+        size_t stride = element.hasList() ? recordSizeAt(element, 0, offset) : element.recordSize();
+        if (element.hasList()) {
+            // 假设所有记录与第一条等长，并行验证；等价于顺序扫描的结果
+            std::atomic<bool> uniform(offset + count * stride <= mapping_->size());
+            if (uniform) {
+                parallelFor(count, [&](size_t begin, size_t end, size_t) {
+                    for (size_t i = begin; i < end && uniform.load(std::memory_order_relaxed); i++) {
+                        if (guessRecordSizeAt(element, offset + i * stride) != stride) uniform = false;
+                    }
+                });
+            }
+            if (!uniform) {
+                size_t pos = offset;
+                for (size_t i = 0; i < count; i++) {
+                    if (records) (*records)[i] = pos;
+                    pos += recordSizeAt(element, i, pos);
+                }
+                return pos;
+            }
+        }
+        if (records) {
+            for (size_t i = 0; i < count; i++) (*records)[i] = offset + i * stride;
+        }
+        return offset + count * stride;
+    }
+
+    void checkRange(size_t first, size_t count) const {
+        if (first > vertexCount() || count > vertexCount() - first) {
+            throw std::out_of_range("Vertex range is out of bounds: " + filename_);
+        }
+    }
+
+    // 映射内存中 [first, first + count) 条记录的起始地址
+    const char* mappedRange(size_t first, size_t count, size_t stride) const {
+        if (header_.dataOffset + (first + count) * stride > mapping_->size()) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+        return mapping_->data() + header_.dataOffset + first * stride;
+    }
+
+    size_t readAt(char* buffer, size_t size, size_t offset) const {
+        return readAt(fd_, filename_, stats_, buffer, size, offset);
+    }
+
+    void readExact(char* buffer, size_t size, size_t offset) const {
+        if (readAt(buffer, size, offset) != size) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+    }
+
+    template<typename>
+    friend class PlyBatchReader;
+    friend class PlyBinaryIO;
+
+    // 沿用调用方已建立的映射和已解析的头部（PlyBinaryIO::read 先据此区分格式），只再打开一次文件
+    PlyReader(const std::string& filename, std::shared_ptr<const MappedFile> mapping, PlyHeader header, PlyIOStats* stats)
+        : filename_(filename), stats_(stats), header_(std::move(header)) {
+        fd_ = openFile(filename_, stats_);
+        try {
+            initialize(std::move(mapping));
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    // 检查格式，建立映射（mapping 为空时），vertex 前面有变长元素时扫描得到它的起始位置
+    void initialize(std::shared_ptr<const MappedFile> mapping) {
+        PlyStatsScope scope(stats_, PlyIOStats::kHeader);
+        if (!header_.isBinary) {
+            throw std::runtime_error("ASCII PLY is not supported: " + filename_);
+        }
+        if (header_.quantized) {
+            throw std::runtime_error("Quantized PLY can only be read with PlyBinaryIO::read: " + filename_);
+        }
+        mapping_ = mapping ? std::move(mapping) : std::make_shared<const MappedFile>(filename_, stats_);
+        for (size_t i = 0; i < header_.elements.size(); i++) {
+            if (header_.elements[i].name == "vertex" && header_.elements[i].offset == PlyElement::npos) {
+                header_.elements[i].offset = elementOffset(i);
+                header_.dataOffset = header_.elements[i].offset;
+            }
+        }
+    }
+
+    static int openFile(const std::string& filename, PlyIOStats* stats) {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file for reading: " + filename);
+        }
+        if (stats) stats->addCalls(1);
+        return fd;
+    }
+
+    // pread 直到读满或到达文件末尾，返回实际读取的字节数
+    static size_t readAt(int fd, const std::string& filename, PlyIOStats* stats, char* buffer, size_t size, size_t offset) {
+        PlyStatsScope scope(stats, PlyIOStats::kIO);
+        size_t done = 0, calls = 0;
+        while (done < size) {
+            const ssize_t got = ::pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+            calls++;
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Failed to read file: " + filename);
+            }
+            if (got == 0) break;
+            done += static_cast<size_t>(got);
+        }
+        if (stats) stats->addRead(done, calls);
+        return done;
+    }
+
+    // 逐步扩大读取范围直到包含 end_header，再解析
+    static PlyHeader readHeader(int fd, const std::string& filename, PlyIOStats* stats) {
+        std::vector<char> buffer;
+        size_t length = 0;
+        for (size_t size = 4096; length == 0; size *= 2) {
+            if (size > (64u << 20)) {
+                throw std::runtime_error("PLY header is missing end_header: " + filename);
+            }
+            buffer.resize(size);
+            const size_t got = readAt(fd, filename, stats, buffer.data(), size, 0);
+            length = findHeaderEnd(buffer.data(), got);
+            if (length == 0 && got < size) {
+                throw std::runtime_error("PLY header is missing end_header: " + filename);
+            }
+        }
+        PlyStatsScope scope(stats, PlyIOStats::kHeader);
+        return parseHeader(buffer.data(), length);
+    }
+
+    std::string filename_;
+    PlyIOStats* stats_ = nullptr;
+    int fd_ = -1;
+    PlyHeader header_;
+    std::shared_ptr<const MappedFile> mapping_;
+};
+
+// 顶点数据的空间分块索引：按文件顺序每 chunkVertices 个顶点一块，记录每块的包围盒
+// 范围查询只读取与查询框相交的块；点的文件顺序越有空间局部性（扫描线、按空间排序后写入），跳过的块越多
+// 索引保存为 PLY 旁边的 <文件名>.idx，记录了顶点数和文件大小，PLY 改变后自动失效
+class PlyChunkIndex {
+public:
+    static constexpr size_t kDefaultChunkVertices = 4096;
+
+    static std::string sidecarPath(const std::string& filename) { return plyIndexSidecarPath(filename); }
+
+    // 扫描全部顶点的位置建立索引
+    static PlyChunkIndex build(const PlyReader& reader, size_t chunkVertices = kDefaultChunkVertices, size_t threads = 0) {
+        const PlyHeader& header = reader.header();
+        for (const char* name : {"x", "y", "z"}) {
+            if (std::none_of(header.properties.begin(), header.properties.end(),
+                             [&](const PlyProperty& property) { return property.name == name; })) {
+                throw std::runtime_error("PLY file has no " + std::string(name) + " property: " + reader.filename());
+            }
+        }
+
+        PlyChunkIndex index;
+        index.chunkVertices_ = std::max<size_t>(1, chunkVertices);
+        index.vertexCount_ = reader.vertexCount();
+        index.fileSize_ = reader.mapping()->size();
+        index.stamp_ = Stamp::of(reader.filename());
+        const size_t chunks = (index.vertexCount_ + index.chunkVertices_ - 1) / index.chunkVertices_;
+        index.bounds_.resize(chunks);
+
+        const ConversionPlan plan = ConversionPlan::compile<PlyPosition>(header);
+        parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+            std::vector<PlyPosition> positions(index.chunkVertices_);
+            for (size_t c = begin; c < end; c++) {
+                const size_t first = c * index.chunkVertices_;
+                const size_t n = std::min(index.chunkVertices_, index.vertexCount_ - first);
+                reader.readRange(plan, first, n, reinterpret_cast<char*>(positions.data()));
+                for (size_t i = 0; i < n; i++) index.bounds_[c].expand(positions[i]);
+            }
+        }, threads);
+        return index;
+    }
+
+    // 读取索引文件；文件不存在、格式不对或与 reader 的 PLY 不匹配时返回 false
+    // 除顶点数和文件大小外还比较 PLY 的设备号、inode、修改和变更时间，文件被改写后索引即失效
+    bool load(const std::string& path, const PlyReader& reader) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        char magic[sizeof(kMagic)] = {};
+        uint64_t fields[4] = {};
+        Stamp stamp;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+        file.read(reinterpret_cast<char*>(&stamp), sizeof(stamp));
+        if (!file || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || fields[0] == 0 ||
+            fields[1] != reader.vertexCount() || fields[2] != reader.mapping()->size() ||
+            fields[3] != (fields[1] + fields[0] - 1) / fields[0] || !(stamp == Stamp::of(reader.filename()))) {
+            return false;
+        }
+        std::vector<PlyBounds> bounds(fields[3]);
+        file.read(reinterpret_cast<char*>(bounds.data()), bounds.size() * sizeof(PlyBounds));
+        if (!file) return false;
+        chunkVertices_ = fields[0];
+        vertexCount_ = fields[1];
+        fileSize_ = fields[2];
+        stamp_ = stamp;
+        bounds_ = std::move(bounds);
+        return true;
+    }
+
+    void save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file for writing: " + path);
+        }
+        const uint64_t fields[4] = {chunkVertices_, vertexCount_, fileSize_, bounds_.size()};
+        file.write(kMagic, sizeof(kMagic));
+        file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        file.write(reinterpret_cast<const char*>(&stamp_), sizeof(stamp_));
+        file.write(reinterpret_cast<const char*>(bounds_.data()), bounds_.size() * sizeof(PlyBounds));
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    }
+
+    // 优先使用旁边的索引文件，没有或已失效时重建并尽量保存（目录不可写时只在内存中使用）
+    static PlyChunkIndex open(const PlyReader& reader, size_t chunkVertices = kDefaultChunkVertices) {
+        PlyChunkIndex index;
+        const std::string path = sidecarPath(reader.filename());
+        if (index.load(path, reader)) return index;
+        index = build(reader, chunkVertices);
+        try {
+            index.save(path);
+        } catch (const std::exception&) {
+        }
+        return index;
+    }
+
+    // 由已知的各块包围盒为已写完的 filename 建立索引，例如写入时顺带计算（见 PlyWriteOptions::chunkIndexVertices）
+    static PlyChunkIndex fromBounds(const std::string& filename, size_t chunkVertices, size_t vertexCount,
+                                    std::vector<PlyBounds> bounds) {
+        PlyChunkIndex index;
+        index.chunkVertices_ = std::max<size_t>(1, chunkVertices);
+        index.vertexCount_ = vertexCount;
+        index.stamp_ = Stamp::of(filename);
+        index.fileSize_ = index.stamp_.size;
+        if (bounds.size() != (vertexCount + index.chunkVertices_ - 1) / index.chunkVertices_) {
+            throw std::invalid_argument("Chunk bounds do not match vertex count");
+        }
+        index.bounds_ = std::move(bounds);
+        return index;
+    }
+
+    size_t chunkVertices() const { return chunkVertices_; }
+    size_t chunks() const { return bounds_.size(); }
+    const PlyBounds& bounds(size_t chunk) const { return bounds_[chunk]; }
+
+    // 整个点云的包围盒
+    PlyBounds bounds() const {
+        PlyBounds all;
+        for (const auto& chunk : bounds_) all.expand(chunk);
+        return all;
+    }
+
+    // 与 box 相交的块对应的顶点范围 [first, first + count)，相邻的块合并
+    std::vector<std::pair<size_t, size_t>> ranges(const PlyBounds& box) const {
+        std::vector<std::pair<size_t, size_t>> result;
+        for (size_t c = 0; c < bounds_.size(); c++) {
+            if (!bounds_[c].intersects(box)) continue;
+            const size_t first = c * chunkVertices_;
+            const size_t count = std::min(chunkVertices_, vertexCount_ - first);
+            if (!result.empty() && result.back().first + result.back().second == first) {
+                result.back().second += count;
+            } else {
+                result.emplace_back(first, count);
+            }
+        }
+        return result;
+    }
+
+    // 读取位置在 box 内的顶点，按文件顺序追加到 out，返回读取的个数
+    // 只按位置读取相交的块：每段读一次文件记录，再分别转换出位置（用于过滤）和顶点
+    template<typename VertexType>
+    size_t query(const PlyReader& reader, const PlyBounds& box, std::vector<VertexType>& out, size_t threads = 0) const {
+        const PlyHeader& header = reader.header();
+        const size_t stride = header.vertexSize();
+        const ConversionPlan raw = ConversionPlan::identity(header.properties, stride, false);
+        const ConversionPlan positionPlan = ConversionPlan::compile<PlyPosition>(header);
+        const ConversionPlan vertexPlan = ConversionPlan::compile<VertexType>(header);
+
+        // 按块切分，便于分给多个线程
+        std::vector<std::pair<size_t, size_t>> pieces;
+        for (const auto& range : ranges(box)) {
+            for (size_t done = 0; done < range.second; done += PlyReader::kBlockVertices) {
+                pieces.emplace_back(range.first + done, std::min(PlyReader::kBlockVertices, range.second - done));
+            }
+        }
+
+        std::vector<std::vector<VertexType>> results(pieces.size());
+        parallelFor(pieces.size(), [&](size_t begin, size_t end, size_t) {
+            PlyUninitializedVector<char> records;
+            std::vector<PlyPosition> positions;
+            std::vector<VertexType> vertices;
+            for (size_t p = begin; p < end; p++) {
+                const size_t first = pieces[p].first;
+                const size_t count = pieces[p].second;
+                records.resize(count * stride);
+                positions.resize(count);
+                vertices.resize(count);
+                reader.readRange(raw, first, count, records.data());
+                positionPlan.apply(records.data(), count, reinterpret_cast<char*>(positions.data()));
+                vertexPlan.apply(records.data(), count, reinterpret_cast<char*>(vertices.data()));
+                for (size_t i = 0; i < count; i++) {
+                    if (box.contains(positions[i])) results[p].push_back(vertices[i]);
+                }
+            }
+        }, threads);
+
+        size_t total = 0;
+        for (const auto& result : results) {
+            out.insert(out.end(), result.begin(), result.end());
+            total += result.size();
+        }
+        return total;
+    }
+
+private:
+    static constexpr char kMagic[8] = {'P', 'L', 'Y', 'I', 'D', 'X', '2', '\n'};
+
+    // 建立索引时 PLY 文件的身份；时间精度不足以区分同一时刻的两次改写，所以本库的写入都会删除旧索引
+    struct Stamp {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        int64_t modified = 0;  // 纳秒
+        int64_t changed = 0;
+
+        static Stamp of(const std::string& filename) {
+            struct stat st;
+            if (::stat(filename.c_str(), &st) != 0) {
+                throw std::runtime_error("Failed to stat file: " + filename);
+            }
+            Stamp stamp;
+            stamp.device = static_cast<uint64_t>(st.st_dev);
+            stamp.inode = static_cast<uint64_t>(st.st_ino);
+            stamp.size = static_cast<uint64_t>(st.st_size);
+            stamp.modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            stamp.changed = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+            return stamp;
+        }
+        bool operator==(const Stamp& other) const {
+            return device == other.device && inode == other.inode && size == other.size && modified == other.modified &&
+                   changed == other.changed;
+        }
+    };
+
+    size_t chunkVertices_ = kDefaultChunkVertices;
+    size_t vertexCount_ = 0;
+    size_t fileSize_ = 0;
+    Stamp stamp_;
+    std::vector<PlyBounds> bounds_;
+};
+
+#if defined(__BMI2__)
+#define PLY_HAS_PEXT
+#endif
+
+// 3 个 21 位整数交错为 63 位 Morton 码
+inline uint64_t mortonEncode(uint32_t x, uint32_t y, uint32_t z) {
+#ifdef PLY_HAS_PEXT
+    return _pdep_u64(x, 0x1249249249249249ull) | _pdep_u64(y, 0x2492492492492492ull) | _pdep_u64(z, 0x4924924924924924ull);
+#else
+    auto split = [](uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    };
+    return split(x) | split(y) << 1 | split(z) << 2;
+#endif
+}
+
+// mortonEncode 的逆运算，axis 为 0/1/2
+inline uint32_t mortonDecode(uint64_t code, int axis) {
+#ifdef PLY_HAS_PEXT
+    return static_cast<uint32_t>(_pext_u64(code, 0x1249249249249249ull << axis));
+#else
+    uint64_t v = (code >> axis) & 0x1249249249249249ull;
+    v = (v | v >> 2) & 0x10c30c30c30c30c3ull;
+    v = (v | v >> 4) & 0x100f00f00f00f00full;
+    v = (v | v >> 8) & 0x1f0000ff0000ffull;
+    v = (v | v >> 16) & 0x1f00000000ffffull;
+    v = (v | v >> 32) & 0x1fffff;
+    return static_cast<uint32_t>(v);
+#endif
+}
+
+// 写入时重新排序顶点所用的空间填充曲线
+enum class PlySpatialOrder {
+    kNone,     // 保持原有顺序
+    kMorton,   // Z 序：计算最快，相邻序号的格子之间偶尔有大跳跃
+    kHilbert,  // Hilbert 序：相邻序号的格子总是相邻，局部性更好
+};
+
+// Hilbert 曲线的状态表：kHilbertStates[状态][卦限] 的低 3 位为该层的序号，其余为下一层的状态（共 24 种朝向）
+// 卦限为 x | y << 1 | z << 2；表由 Skilling 的转置算法逐层展开得到，与它对任意位数的结果一致
+inline constexpr uint8_t kHilbertStates[24][8] = {
+    {8, 23, 27, 36, 41, 54, 2, 5},
+    {56, 67, 73, 10, 87, 44, 94, 13},
+    {100, 111, 21, 78, 51, 112, 18, 89},
+    {110, 79, 29, 124, 113, 88, 26, 3},
+    {72, 57, 123, 34, 95, 86, 4, 37},
+    {32, 131, 143, 12, 1, 42, 150, 45},
+    {156, 31, 19, 160, 53, 6, 50, 145},
+    {0, 33, 151, 142, 171, 58, 76, 61},
+    {126, 69, 177, 66, 39, 132, 136, 11},
+    {40, 55, 9, 22, 107, 60, 74, 77},
+    {188, 85, 91, 82, 127, 38, 176, 137},
+    {116, 83, 93, 90, 71, 96, 14, 17},
+    {98, 121, 101, 182, 155, 24, 20, 167},
+    {30, 7, 161, 144, 109, 172, 106, 75},
+    {114, 187, 117, 92, 25, 120, 166, 183},
+    {70, 97, 125, 122, 15, 16, 28, 35},
+    {174, 133, 63, 68, 185, 130, 80, 43},
+    {180, 141, 175, 62, 147, 138, 184, 81},
+    {164, 139, 135, 152, 149, 146, 46, 49},
+    {154, 169, 99, 104, 157, 190, 52, 119},
+    {162, 179, 105, 168, 165, 148, 118, 191},
+    {134, 153, 47, 48, 173, 170, 108, 59},
+    {178, 181, 65, 102, 163, 140, 128, 159},
+    {186, 189, 115, 84, 129, 158, 64, 103},
+};
+
+// 3 个 bits 位整数的 Hilbert 曲线序号，从最高位起每层查一次状态表
+inline uint64_t hilbertEncode(uint32_t x, uint32_t y, uint32_t z, int bits = 21) {
+    uint64_t code = 0;
+    unsigned state = 0;
+    for (int bit = bits - 1; bit >= 0; bit--) {
+        const unsigned octant = ((x >> bit) & 1u) | ((y >> bit) & 1u) << 1 | ((z >> bit) & 1u) << 2;
+        const uint8_t entry = kHilbertStates[state][octant];
+        code = code << 3 | (entry & 7u);
+        state = entry >> 3;
+    }
+    return code;
+}
+
+// 基数排序的元素：键和原下标
+struct PlySortEntry {
+    uint64_t key;
+    uint64_t index;
+};
+
+// 按键的低 keyBits 位做稳定的并行 LSD 基数排序，每趟 11 位
+// 每趟各线程先统计自己区间的直方图，按（位值, 线程）求前缀和后各自分散到另一个数组；所有键在这一趟的位都相同时跳过
+inline void radixSort(PlyUninitializedVector<PlySortEntry>& entries, int keyBits = 64, size_t threads = 0) {
+    constexpr int kDigitBits = 11;
+    constexpr size_t kBuckets = size_t(1) << kDigitBits;
+    const size_t count = entries.size();
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // 每个线程的区间至少与直方图一样大，否则统计和求前缀和的开销占主导
+    const size_t parts = std::max<size_t>(1, std::min(threads, count / kBuckets));
+    PlyUninitializedVector<PlySortEntry> buffer(count);
+    std::vector<size_t> counts(parts * kBuckets);
+    for (int shift = 0; shift < keyBits; shift += kDigitBits) {
+        const PlySortEntry* src = entries.data();
+        PlySortEntry* dst = buffer.data();
+        std::fill(counts.begin(), counts.end(), 0);
+        parallelFor(parts, [&](size_t p, size_t, size_t) {
+            size_t* histogram = &counts[p * kBuckets];
+            for (size_t i = count * p / parts; i < count * (p + 1) / parts; i++) histogram[(src[i].key >> shift) & (kBuckets - 1)]++;
+        }, parts);
+
+        size_t offset = 0;
+        bool trivial = false;
+        for (size_t digit = 0; digit < kBuckets; digit++) {
+            size_t total = 0;
+            for (size_t p = 0; p < parts; p++) {
+                const size_t n = counts[p * kBuckets + digit];
+                counts[p * kBuckets + digit] = offset + total;
+                total += n;
+            }
+            trivial = trivial || total == count;
+            offset += total;
+        }
+        if (trivial) continue;
+
+        parallelFor(parts, [&](size_t p, size_t, size_t) {
+            size_t* next = &counts[p * kBuckets];
+            for (size_t i = count * p / parts; i < count * (p + 1) / parts; i++) dst[next[(src[i].key >> shift) & (kBuckets - 1)]++] = src[i];
+        }, parts);
+        entries.swap(buffer);
+    }
+}
+
+// 把 stride 字节的记录（系统字节序）转换为 PlyPosition 的计划，layout 中缺少 x、y、z 时抛出异常
+inline ConversionPlan positionPlan(const std::vector<PlyProperty>& layout, size_t stride) {
+    for (const char* name : {"x", "y", "z"}) {
+        if (std::none_of(layout.begin(), layout.end(), [&](const PlyProperty& property) { return property.name == name; })) {
+            throw std::invalid_argument("Vertex layout has no " + std::string(name) + " property");
+        }
+    }
+    return ConversionPlan::compile(layout, stride, isLittleEndian(), vertexLayout<PlyPosition>(), sizeof(PlyPosition), isLittleEndian());
+}
+
+// 计算顶点沿空间填充曲线的顺序：返回的 order[i] 为排序后第 i 个顶点在 records 中的下标
+// 坐标按包围盒归一化到格子，每轴的位数只取到平均每格远少于一个点（最多 21 位），基数排序的趟数随之减少；
+// 同一格内以及坐标不是有限值的顶点（排在最后）保持原有顺序
+inline PlyUninitializedVector<uint64_t> spatialOrder(const char* records, size_t count, const ConversionPlan& plan,
+                                                      PlySpatialOrder curve, size_t threads = 0) {
+    constexpr size_t kTile = 4096;
+    int levels = 3;
+    while (levels < 21 && (uint64_t(1) << (3 * (levels - 3))) < count) levels++;
+    const uint32_t cellsPerAxis = (1u << levels) - 1;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t tiles = (count + kTile - 1) / kTile;
+
+    // 第一遍：有限坐标的包围盒
+    std::vector<PlyBounds> partial(threads);
+    parallelFor(tiles, [&](size_t begin, size_t end, size_t t) {
+        std::vector<PlyPosition> positions(kTile);
+        for (size_t tile = begin; tile < end; tile++) {
+            const size_t first = tile * kTile;
+            const size_t n = std::min(kTile, count - first);
+            plan.apply(records + first * plan.srcStride(), n, reinterpret_cast<char*>(positions.data()));
+            for (size_t i = 0; i < n; i++) {
+                const PlyPosition& p = positions[i];
+                if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) partial[t].expand(p);
+            }
+        }
+    }, threads);
+    PlyBounds bounds;
+    for (const auto& part : partial) bounds.expand(part);
+    double scale[3] = {0, 0, 0};
+    for (int axis = 0; axis < 3; axis++) {
+        const double extent = static_cast<double>(bounds.max[axis]) - bounds.min[axis];
+        if (extent > 0) scale[axis] = cellsPerAxis / extent;
+    }
+
+    // 第二遍：曲线上的序号，非有限坐标用序号之上的一位排到最后
+    PlyUninitializedVector<PlySortEntry> entries(count);
+    parallelFor(tiles, [&](size_t begin, size_t end, size_t) {
+        std::vector<PlyPosition> positions(kTile);
+        for (size_t tile = begin; tile < end; tile++) {
+            const size_t first = tile * kTile;
+            const size_t n = std::min(kTile, count - first);
+            plan.apply(records + first * plan.srcStride(), n, reinterpret_cast<char*>(positions.data()));
+            for (size_t i = 0; i < n; i++) {
+                const float coordinates[3] = {positions[i].x, positions[i].y, positions[i].z};
+                uint32_t cells[3];
+                bool finite = true;
+                for (int axis = 0; axis < 3; axis++) {
+                    finite = finite && std::isfinite(coordinates[axis]);
+                    const double cell = (static_cast<double>(coordinates[axis]) - bounds.min[axis]) * scale[axis];
+                    cells[axis] = finite ? static_cast<uint32_t>(std::min<double>(cellsPerAxis, std::max(0.0, cell))) : 0;
+                }
+                uint64_t key = uint64_t(1) << (3 * levels);
+                if (finite) {
+                    key = curve == PlySpatialOrder::kHilbert ? hilbertEncode(cells[0], cells[1], cells[2], levels)
+                                                             : mortonEncode(cells[0], cells[1], cells[2]);
+                }
+                entries[first + i] = PlySortEntry{key, first + i};
+            }
+        }
+    }, threads);
+
+    radixSort(entries, 3 * levels + 1, threads);
+    PlyUninitializedVector<uint64_t> order(count);
+    parallelFor(count, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) order[i] = entries[i].index;
+    }, threads);
+    return order;
+}
+
+// 分块量化编码：xyz 按固定精度量化，块内按空间分成每轴 2^21 个精度单位的单元，单元内坐标为 21 位定点数，
+// 按（单元、Morton 码）排序后对单元内相邻码的差值按 128 个一组定宽位打包；其余属性按列原样存储（同样按排序后的顺序）
+// 块格式（小端）：精度 double、顶点数 uint32、单元数 uint32，然后是各单元、各属性列
+// 单元格式：原点 double[3]、顶点数 uint32、组数 uint32、每组位宽 uint8[组数]（补齐到 8 字节）、
+// 打包的差值（每组 2 * 位宽 个 uint64）
+class PlyQuantizedCodec {
+public:
+    static constexpr size_t kGroup = 128;
+    static constexpr unsigned kBits = 21;
+    static constexpr uint32_t kMaxCode = (1u << kBits) - 1;
+    // 单元下标（每轴 2^21 个精度单位为一格）同样按 Morton 码排序，因此每轴最多 2^42 个精度单位
+    static constexpr double kMaxSteps = static_cast<double>(1ull << (2 * kBits));
+
+    // layout 为记录布局（每条 stride 字节），其中 x、y、z 必须是 float 或 double
+    PlyQuantizedCodec(const std::vector<PlyProperty>& layout, size_t stride) : stride_(stride) {
+        if (!isLittleEndian()) {
+            throw std::runtime_error("Quantized PLY requires a little-endian host");
+        }
+        const char* names[3] = {"x", "y", "z"};
+        for (int a = 0; a < 3; a++) {
+            auto found = std::find_if(layout.begin(), layout.end(), [&](const PlyProperty& property) { return property.name == names[a]; });
+            if (found == layout.end() || (found->type != PropertyType::FLOAT && found->type != PropertyType::DOUBLE)) {
+                throw std::runtime_error("Quantized encoding needs float or double x, y, z");
+            }
+            axes_[a] = *found;
+        }
+        for (const auto& property : layout) {
+            if (property.isList) {
+                throw std::runtime_error("Quantized encoding does not support list property: " + property.name);
+            }
+            if (property.name != "x" && property.name != "y" && property.name != "z") attributes_.push_back(property);
+        }
+    }
+
+    // 把 count 条记录（不超过 2^32 - 1）编码为一块，step 为量化精度，解码误差不超过 step / 2。
+    // 范围超过 2^21 个 step 的轴不放大精度，而是把块按空间切成边长 2^21 个 step 的单元，各单元记录自己的原点
+    void encode(const char* records, size_t count, double step, std::string& out) const {
+        ChunkHeader header{};
+        header.count = static_cast<uint32_t>(count);
+        header.step = step;
+
+        // 每个坐标量化成相对块内最小值的整数 steps，高位为单元下标、低 21 位为单元内的定点数
+        std::vector<double> values(3 * count);
+        double low[3];
+        for (int a = 0; a < 3; a++) {
+            low[a] = std::numeric_limits<double>::max();
+            double high = std::numeric_limits<double>::lowest();
+            for (size_t i = 0; i < count; i++) {
+                const double v = loadAxis(records + i * stride_, a);
+                if (!std::isfinite(v)) {
+                    throw std::runtime_error("Cannot quantize a non-finite coordinate");
+                }
+                values[a * count + i] = v;
+                low[a] = std::min(low[a], v);
+                high = std::max(high, v);
+            }
+            if (count > 0 && !((high - low[a]) / step < kMaxSteps - 1)) {
+                throw std::invalid_argument("Quantization step is too small for the coordinate range");
+            }
+        }
+
+        std::vector<Entry> entries(count);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t cell[3], q[3];
+            for (int a = 0; a < 3; a++) {
+                const auto steps = static_cast<uint64_t>(std::nearbyint((values[a * count + i] - low[a]) / step));
+                cell[a] = static_cast<uint32_t>(steps >> kBits);
+                q[a] = static_cast<uint32_t>(steps & kMaxCode);
+            }
+            entries[i] = {mortonEncode(cell[0], cell[1], cell[2]), mortonEncode(q[0], q[1], q[2]), static_cast<uint32_t>(i)};
+        }
+        std::sort(entries.begin(), entries.end());
+
+        // 相同单元下标的一段为一个单元，单元内差值分组，每组取能容纳最大差值的位宽
+        std::vector<size_t> cellBegin;
+        for (size_t i = 0; i < count; i++) {
+            if (i == 0 || entries[i].cell != entries[i - 1].cell) cellBegin.push_back(i);
+        }
+        cellBegin.push_back(count);
+        header.cells = static_cast<uint32_t>(cellBegin.size() - 1);
+        auto delta = [&](size_t i, size_t begin) { return entries[i].code - (i > begin ? entries[i - 1].code : 0); };
+        std::vector<std::vector<uint8_t>> widths(header.cells);
+        size_t bytes = sizeof(ChunkHeader);
+        for (size_t c = 0; c < header.cells; c++) {
+            const size_t begin = cellBegin[c], end = cellBegin[c + 1];
+            widths[c].resize((end - begin + kGroup - 1) / kGroup);
+            size_t words = 0;
+            for (size_t g = 0; g < widths[c].size(); g++) {
+                uint64_t bits = 0;
+                for (size_t i = begin + g * kGroup; i < std::min(end, begin + (g + 1) * kGroup); i++) bits |= delta(i, begin);
+                widths[c][g] = static_cast<uint8_t>(bits == 0 ? 0 : 64 - __builtin_clzll(bits));
+                words += 2 * widths[c][g];
+            }
+            bytes += sizeof(CellHeader) + (widths[c].size() + 7) / 8 * 8 + words * sizeof(uint64_t);
+        }
+        for (const auto& property : attributes_) bytes += property.size * count;
+        out.assign(bytes, '\0');
+        char* p = &out[0];
+        std::memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+
+        std::vector<uint64_t> packed(2 * 64);
+        for (size_t c = 0; c < header.cells; c++) {
+            const size_t begin = cellBegin[c], end = cellBegin[c + 1];
+            CellHeader cell{};
+            cell.count = static_cast<uint32_t>(end - begin);
+            cell.groups = static_cast<uint32_t>(widths[c].size());
+            for (int a = 0; a < 3; a++) {
+                const uint64_t index = mortonDecode(entries[begin].cell, a);
+                cell.origin[a] = low[a] + static_cast<double>(index << kBits) * step;
+            }
+            std::memcpy(p, &cell, sizeof(cell));
+            std::memcpy(p + sizeof(cell), widths[c].data(), widths[c].size());
+            p += sizeof(cell) + (widths[c].size() + 7) / 8 * 8;
+            for (size_t g = 0; g < widths[c].size(); g++) {
+                const unsigned width = widths[c][g];
+                if (width == 0) continue;
+                std::fill(packed.begin(), packed.end(), 0);
+                for (size_t k = 0; k < kGroup && begin + g * kGroup + k < end; k++) {
+                    const uint64_t value = delta(begin + g * kGroup + k, begin);
+                    const size_t bit = k * width;
+                    packed[bit / 64] |= value << (bit % 64);
+                    if (bit % 64 + width > 64) packed[bit / 64 + 1] |= value >> (64 - bit % 64);
+                }
+                std::memcpy(p, packed.data(), 2 * width * sizeof(uint64_t));
+                p += 2 * width * sizeof(uint64_t);
+            }
+        }
+
+        for (const auto& property : attributes_) {
+            for (size_t i = 0; i < count; i++) {
+                std::memcpy(p + i * property.size, records + entries[i].index * stride_ + property.offset, property.size);
+            }
+            p += property.size * count;
+        }
+    }
+
+    size_t stride() const { return stride_; }
+
+    // 块中的顶点数
+    static size_t chunkCount(const char* chunk, size_t size) {
+        ChunkHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("Quantized chunk is truncated");
+        }
+        std::memcpy(&header, chunk, sizeof(header));
+        return header.count;
+    }
+
+    // 把 size 字节的一块解码为记录 records（至少容纳 chunkCount 条）
+    void decode(const char* chunk, size_t size, char* records) const {
+        const char* end = chunk + size;
+        ChunkHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("Quantized chunk is truncated");
+        }
+        std::memcpy(&header, chunk, sizeof(header));
+        const size_t count = header.count;
+        if (header.cells > count || (count > 0 && header.cells == 0)) {
+            throw std::runtime_error("Quantized chunk is corrupt");
+        }
+        const char* p = chunk + sizeof(header);
+
+        // 逐单元解包差值并累加出 Morton 码，再按轴拆成定点数并还原坐标
+        std::vector<uint64_t> codes(count);
+        std::vector<int32_t> q(count);
+        uint64_t packed[2 * 64 + 1] = {};
+        size_t first = 0;
+        for (size_t c = 0; c < header.cells; c++) {
+            CellHeader cell;
+            if (static_cast<size_t>(end - p) < sizeof(cell)) {
+                throw std::runtime_error("Quantized chunk is truncated");
+            }
+            std::memcpy(&cell, p, sizeof(cell));
+            const size_t n = cell.count;
+            const size_t widthBytes = (static_cast<size_t>(cell.groups) + 7) / 8 * 8;
+            if (n == 0 || n > count - first || cell.groups != (n + kGroup - 1) / kGroup) {
+                throw std::runtime_error("Quantized chunk is corrupt");
+            }
+            if (static_cast<size_t>(end - p) < sizeof(cell) + widthBytes) {
+                throw std::runtime_error("Quantized chunk is truncated");
+            }
+            const uint8_t* widths = reinterpret_cast<const uint8_t*>(p + sizeof(cell));
+            size_t words = 0;
+            for (size_t g = 0; g < cell.groups; g++) {
+                if (widths[g] > 64) throw std::runtime_error("Quantized chunk is corrupt");
+                words += 2 * widths[g];
+            }
+            p += sizeof(cell) + widthBytes;
+            if (static_cast<size_t>(end - p) < words * sizeof(uint64_t)) {
+                throw std::runtime_error("Quantized chunk is truncated");
+            }
+
+            // 每组 128 个差值定宽打包；每个差值都读相邻两个字，组后补一个 0 字，循环内没有分支
+            uint64_t* out = codes.data() + first;
+            uint64_t code = 0;
+            for (size_t g = 0; g < cell.groups; g++) {
+                const unsigned width = widths[g];
+                std::memcpy(packed, p, 2 * width * sizeof(uint64_t));
+                packed[2 * width] = 0;
+                p += 2 * width * sizeof(uint64_t);
+                const uint64_t mask = width == 64 ? ~0ull : (1ull << width) - 1;
+                const size_t m = std::min(kGroup, n - g * kGroup);
+                for (size_t k = 0, bit = 0; k < m; k++, bit += width) {
+                    const unsigned shift = bit % 64;
+                    const uint64_t value = packed[bit / 64] >> shift | (packed[bit / 64 + 1] << 1) << (63 - shift);
+                    code += value & mask;
+                    out[g * kGroup + k] = code;
+                }
+            }
+
+            // 每轴单独一遍循环，便于向量化：定点数不超过 21 位，按 int32 转 double；
+            // stride 放在局部变量中，否则写 records 可能改写 stride_，循环无法向量化
+            const size_t stride = stride_;
+            for (int a = 0; a < 3; a++) {
+                const uint64_t* source = codes.data() + first;
+                int32_t* values = q.data() + first;
+                for (size_t i = 0; i < n; i++) values[i] = static_cast<int32_t>(mortonDecode(source[i], a));
+                const double origin = cell.origin[a], step = header.step;
+                char* target = records + first * stride + axes_[a].offset;
+                if (axes_[a].type == PropertyType::FLOAT) {
+                    for (size_t i = 0; i < n; i++) {
+                        const float v = static_cast<float>(origin + values[i] * step);
+                        std::memcpy(target + i * stride, &v, sizeof(v));
+                    }
+                } else {
+                    for (size_t i = 0; i < n; i++) {
+                        const double v = origin + values[i] * step;
+                        std::memcpy(target + i * stride, &v, sizeof(v));
+                    }
+                }
+            }
+            first += n;
+        }
+        if (first != count) {
+            throw std::runtime_error("Quantized chunk is corrupt");
+        }
+
+        size_t attributeBytes = 0;
+        for (const auto& property : attributes_) attributeBytes += property.size * count;
+        if (static_cast<size_t>(end - p) < attributeBytes) {
+            throw std::runtime_error("Quantized chunk is truncated");
+        }
+        for (const auto& property : attributes_) {
+            copyColumn(p, property.size, records + property.offset, stride_, property.size, count);
+            p += property.size * count;
+        }
+    }
+
+private:
+    struct ChunkHeader {
+        double step;
+        uint32_t count;
+        uint32_t cells;
+    };
+    struct CellHeader {
+        double origin[3];
+        uint32_t count;
+        uint32_t groups;
+    };
+    struct Entry {
+        uint64_t cell;  // 单元下标的 Morton 码
+        uint64_t code;  // 单元内定点数的 Morton 码
+        uint32_t index;
+        bool operator<(const Entry& other) const { return cell != other.cell ? cell < other.cell : code < other.code; }
+    };
+
+    double loadAxis(const char* record, int axis) const {
+        if (axes_[axis].type == PropertyType::FLOAT) {
+            float v;
+            std::memcpy(&v, record + axes_[axis].offset, sizeof(v));
+            return v;
+        }
+        double v;
+        std::memcpy(&v, record + axes_[axis].offset, sizeof(v));
+        return v;
+    }
+
+    size_t stride_;
+    PlyProperty axes_[3];
+    std::vector<PlyProperty> attributes_;
+};
+
+// 写入选项
+struct PlyWriteOptions {
+    bool littleEndian = isLittleEndian();  // 输出字节序
+    size_t threads = 0;                    // 写入线程数，0 表示全部硬件线程
+    bool ascii = false;                    // 写成 format ascii 1.0（忽略 littleEndian）
+    // 大于 0 时按此精度（坐标单位）量化 xyz 并分块压缩，写成 format binary_quantized 1.0
+    // 读回的坐标与原值相差不超过 quantization / 2（另加 float 的舍入）；每块每轴的范围不能超过 2^42 个精度单位
+    // 块内顶点按 Morton 顺序存储，读回的顺序与写入时不同；不支持面片
+    double quantization = 0;
+    PlyIOStats* stats = nullptr;  // 非空时累加写入统计
+    PlyCloudStats* cloudStats = nullptr;  // 非空时写入的同时统计包围盒等（直方图按其中预先设置的属性）
+    // 把包围盒写成头部的 obj_info bbox 行，之后打开时不必扫描数据；头部先以定宽占位，数据写完后回填
+    bool boundsInHeader = false;
+    // 写入前把顶点沿空间填充曲线重新排序（不修改调用方的数组，面片下标随之改写），文件中相邻的顶点在空间上也相邻
+    // 需要顶点有 x、y、z 成员；只用于 PlyBinaryIO::write
+    PlySpatialOrder order = PlySpatialOrder::kNone;
+    // 大于 0 时按每块这么多顶点建立 PlyChunkIndex 并保存为旁边的 .idx 文件，之后的范围查询不必扫描；只用于未压缩的二进制
+    size_t chunkIndexVertices = 0;
+};
+
+// 头部的 format 行
+inline void writePlyFormat(std::ostream& file, const PlyWriteOptions& options) {
+    if (options.ascii)
+        file << "format ascii 1.0\n";
+    else if (options.quantization > 0)
+        file << "format binary_quantized 1.0\n";
+    else if (options.littleEndian)
+        file << "format binary_little_endian 1.0\n";
+    else
+        file << "format binary_big_endian 1.0\n";
+}
+
+// 包围盒的 obj_info 行，每个数都是定宽的（float 范围内 %+.8e 恒为 15 个字符），空包围盒也一样
+inline std::string plyBoundsInfo(const PlyBounds& bounds) {
+    char line[128];
+    std::snprintf(line, sizeof(line), "obj_info bbox %+.8e %+.8e %+.8e %+.8e %+.8e %+.8e\n", bounds.min[0], bounds.min[1],
+                  bounds.min[2], bounds.max[0], bounds.max[1], bounds.max[2]);
+    return line;
+}
+
+// 按属性列表写入头部，vertexCount 为顶点数的文本（追加写入时是预留的定宽字段）
+// extraElements 为 vertex 之后其他元素的头部文本；bounds 非空时写入 obj_info bbox 行
+inline void writePlyHeader(std::ostream& file, const std::vector<PlyProperty>& layout, const std::string& vertexCount,
+                           const PlyWriteOptions& options, const std::string& extraElements = std::string(),
+                           const PlyBounds* bounds = nullptr) {
+    file << "ply\n";
+    writePlyFormat(file, options);
+    if (bounds) file << plyBoundsInfo(*bounds);
+    file << "element vertex " << vertexCount << "\n";
+    for (const auto& property : layout) {
+        file << "property " << propertyTypeName(property.type) << " " << property.name << "\n";
+    }
+    file << extraElements;
+    file << "end_header\n";
+}
+
+// 在 [0, size) 中按换行切成约 chunkCount 块，返回块边界（每块从行首开始）
+inline std::vector<size_t> splitLines(const char* data, size_t size, size_t chunkCount) {
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < chunkCount; i++) {
+        size_t pos = std::max(bounds.back(), size * i / chunkCount);
+        const void* newline = pos < size ? std::memchr(data + pos, '\n', size - pos) : nullptr;
+        pos = newline ? static_cast<const char*>(newline) - data + 1 : size;
+        if (pos > bounds.back() && pos < size) bounds.push_back(pos);
+    }
+    bounds.push_back(size);
+    return bounds;
+}
+
+// [first, last) 中的行数，末尾没有换行的半行也算一行
+inline size_t countLines(const char* first, const char* last) {
+    size_t lines = std::count(first, last, '\n');
+    if (last > first && last[-1] != '\n') lines++;
+    return lines;
+}
+
+// ASCII PLY 的一行与一条记录（系统字节序，按 layout 排列）之间的转换
+// 每个属性一个值，空白分隔；数值用 from_chars 解析、to_chars 输出（浮点为最短可往返表示）
+class PlyAsciiCodec {
+public:
+    explicit PlyAsciiCodec(const std::vector<PlyProperty>& layout) {
+        for (const auto& property : layout) {
+            if (property.isList || property.size == 0) {
+                throw std::runtime_error("Unsupported ASCII property: " + property.name);
+            }
+            Field field{property.offset, nullptr, nullptr};
+            dispatchPropertyType(property.type, [&](auto value) {
+                field.parse = &parseField<decltype(value)>;
+                field.format = &formatField<decltype(value)>;
+            });
+            fields_.push_back(field);
+            maxLength_ += maxChars(property.type) + 1;
+        }
+    }
+
+    // 一行（含换行）最多的字符数
+    size_t maxLength() const { return std::max<size_t>(1, maxLength_); }
+
+    // 解析一行（不含换行）到 record，格式错误返回 false
+    bool parse(const char* p, const char* end, char* record) const {
+        for (const auto& field : fields_) {
+            p = field.parse(p, end, record + field.offset);
+            if (!p) return false;
+        }
+        while (p < end && isSpace(*p)) p++;
+        return p == end;
+    }
+
+    // 把 record 格式化为一行写到 out（至少 maxLength() 字节），返回写入的结尾
+    char* format(const char* record, char* out) const {
+        for (const auto& field : fields_) {
+            out = field.format(record + field.offset, out);
+            *out++ = ' ';
+        }
+        if (!fields_.empty()) out--;
+        *out++ = '\n';
+        return out;
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    static size_t maxChars(PropertyType type) {
+        switch (type) {
+            case PropertyType::FLOAT: return 16;
+            case PropertyType::DOUBLE: return 24;
+            default: return std::numeric_limits<uint32_t>::digits10 + 2;
+        }
+    }
+
+private:
+    struct Field {
+        size_t offset;
+        const char* (*parse)(const char*, const char*, char*);
+        char* (*format)(const char*, char*);
+    };
+
+    template<typename T>
+    static const char* parseField(const char* p, const char* end, char* out) {
+        while (p < end && isSpace(*p)) p++;
+        T value;
+        const auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || (result.ptr < end && !isSpace(*result.ptr))) return nullptr;
+        std::memcpy(out, &value, sizeof(T));
+        return result.ptr;
+    }
+
+    template<typename T>
+    static char* formatField(const char* in, char* out) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        return std::to_chars(out, out + 32, value).ptr;
+    }
+
+    std::vector<Field> fields_;
+    size_t maxLength_ = 0;
+};
+
+class PlyBinaryIO {
+public:
+    // 构造函数传入文件名
+    PlyBinaryIO(const std::string& filename) : filename_(filename) {}
+
+    // 之后的读写累加统计到 stats（为空时关闭）；写入时 PlyWriteOptions::stats 优先
+    void setStats(PlyIOStats* stats) { stats_ = stats; }
+
+    // 读取 PLY 文件（多线程），支持二进制和 ASCII 格式
+    // 使用 PlyUninitializedAllocator（或以它包装的自定义分配器）时不会先把数组清零
+    template<typename VertexType, typename Allocator>
+    void read(std::vector<VertexType, Allocator>& vertices) {
+        readTo<VertexType>([&](size_t count) {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(count);
+            return vertices.data();
+        });
+    }
+
+    // 读取的同时统计包围盒、非有限坐标和 cloudStats 中设置的直方图，见 PlyReader::read
+    template<typename VertexType, typename Allocator>
+    void read(std::vector<VertexType, Allocator>& vertices, PlyCloudStats& cloudStats) {
+        readTo<VertexType>([&](size_t count) {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(count);
+            return vertices.data();
+        }, &cloudStats);
+    }
+
+    // 读取到调用方提供的内存（内存池、大页、锁页内存等，可以未初始化），返回顶点数
+    // 文件中的顶点数超过 capacity 时抛出异常，不写入 vertices
+    template<typename VertexType>
+    size_t read(VertexType* vertices, size_t capacity) {
+        return readTo<VertexType>([&](size_t count) {
+            if (count > capacity) {
+                throw std::length_error("PLY file has " + std::to_string(count) + " vertices, buffer holds " +
+                                        std::to_string(capacity) + ": " + filename_);
+            }
+            return vertices;
+        });
+    }
+
+    // 流式分批读取，见 PlyReader::readBatches
+    template<typename VertexType, typename Func>
+    size_t readBatches(size_t batchSize, Func&& func) {
+        PlyReader reader(filename_, stats_);
+        vertex_count_ = reader.vertexCount();
+        return reader.readBatches<VertexType>(batchSize, std::forward<Func>(func));
+    }
+
+    // 读取时降采样（抽取、随机采样或体素平均），见 PlyReader::readDecimated；返回保留的点数
+    template<typename VertexType, typename Allocator>
+    size_t readDecimated(const PlyDecimation& decimation, std::vector<VertexType, Allocator>& vertices) {
+        PlyReader reader(filename_, stats_);
+        vertex_count_ = reader.vertexCount();
+        return reader.readDecimated(decimation, vertices);
+    }
+
+    // 读取包围盒 box 内的顶点，使用旁边的空间索引（没有时建立并保存），只读取相交的块
+    template<typename VertexType>
+    size_t readBox(const PlyBounds& box, std::vector<VertexType>& vertices) {
+        PlyReader reader(filename_, stats_);
+        vertex_count_ = reader.vertexCount();
+        vertices.clear();
+        return PlyChunkIndex::open(reader).query(reader, box, vertices);
+    }
+
+    // 以内存映射方式读取，布局和字节序与结构体一致时零拷贝
+    template<typename VertexType>
+    PlyVertexView<VertexType> readMapped() {
+        static_assert(std::is_trivially_copyable_v<VertexType>, "顶点类型必须可平凡复制");
+        const PlyReader reader(filename_, stats_);
+        std::shared_ptr<const MappedFile> mapping = reader.mapping();
+        const char* begin = mapping->data();
+        const PlyHeader& header = reader.header();
+        vertex_count_ = header.vertexCount;
+
+        const ConversionPlan plan = ConversionPlan::compile<VertexType>(header);
+        if (header.dataOffset + vertex_count_ * plan.srcStride() > mapping->size()) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+        const char* payload = begin + header.dataOffset;
+        if (plan.isIdentity() && !plan.needsSwap() && reinterpret_cast<uintptr_t>(payload) % alignof(VertexType) == 0) {
+            return PlyVertexView<VertexType>(std::move(mapping), reinterpret_cast<const VertexType*>(payload), vertex_count_);
+        }
+
+        // 布局或字节序不一致、或数据起点未对齐时，转换（或整体拷贝）到自有内存
+        std::shared_ptr<std::vector<VertexType>> owned;
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            owned = std::make_shared<std::vector<VertexType>>(vertex_count_);
+        }
+        if (stats_) stats_->addMapped(vertex_count_ * plan.srcStride());
+        PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+        plan.apply(payload, vertex_count_, reinterpret_cast<char*>(owned->data()));
+        const VertexType* data = owned->data();
+        return PlyVertexView<VertexType>(std::move(owned), data, vertex_count_);
+    }
+
+    // 按列读取，见 PlyReader::readColumns
+    void readColumns(PlyColumns& columns) {
+        PlyReader reader(filename_, stats_);
+        vertex_count_ = reader.vertexCount();
+        reader.readColumns(columns);
+    }
+
+    // 列投影：只读取 names 中的属性
+    PlyColumns readColumns(const std::vector<std::string>& names) {
+        PlyReader reader(filename_, stats_);
+        vertex_count_ = reader.vertexCount();
+        return reader.readColumns(names);
+    }
+
+    // 写入列式数据：各线程把各列交错成记录后写出，属性顺序即列顺序
+    void writeColumns(const PlyColumns& columns, const PlyWriteOptions& options = PlyWriteOptions()) {
+        vertex_count_ = columns.rows();
+        const std::vector<PlyProperty> layout = columns.recordLayout();
+        const size_t stride = layoutSize(layout);
+        const EndianSwapper swapper = options.littleEndian != isLittleEndian() ? EndianSwapper::forLayout(layout, stride) : EndianSwapper();
+
+        if (options.order != PlySpatialOrder::kNone || options.chunkIndexVertices > 0) {
+            throw std::invalid_argument("writeColumns keeps the row order and writes no chunk index: " + filename_);
+        }
+        PlyIOStats* stats = options.stats ? options.stats : stats_;
+        PlyCloudStats headerStats;
+        PlyCloudStats* cloudStats = cloudStatsFor(options, headerStats);
+        std::unique_ptr<const PlyStatsCollector> collector;
+        if (cloudStats) collector = std::make_unique<const PlyStatsCollector>(layout, stride, isLittleEndian(), *cloudStats);
+        auto makeHeader = [&](const PlyBounds* bounds) {
+            PlyStatsScope scope(stats, PlyIOStats::kHeader);
+            std::ostringstream header;
+            writeHeader(header, layout, options, bounds);
+            return header.str();
+        };
+        const PlyBounds placeholder;
+        const std::string text = makeHeader(options.boundsInHeader ? &placeholder : nullptr);
+        // 第 first 起的 n 条记录交错到 records（系统字节序），需要时顺带统计
+        auto interleave = [&](size_t first, size_t n, char* records) {
+            for (size_t c = 0; c < layout.size(); c++) {
+                const size_t size = layout[c].size;
+                copyColumn(columns.columns()[c].data.data() + first * size, size, records + layout[c].offset, stride, size, n);
+            }
+            if (collector) collector->add(records, n);
+        };
+        // 编码器可能因布局不支持而抛出，先建好再打开（截断）输出
+        std::unique_ptr<const PlyAsciiCodec> asciiCodec;
+        std::unique_ptr<const PlyQuantizedCodec> quantizedCodec;
+        if (options.ascii) {
+            asciiCodec = std::make_unique<const PlyAsciiCodec>(layout);
+        } else if (options.quantization > 0) {
+            quantizedCodec = std::make_unique<const PlyQuantizedCodec>(layout, stride);
+        }
+
+        PlyOutputFile file(filename_, stats);
+        if (asciiCodec) {
+            file.writeAt(text.data(), text.size(), 0);
+            writeBlocks(file, text.size(), vertex_count_, options.threads, [&](size_t first, size_t n, std::string& out) {
+                PlyUninitializedVector<char> records(n * stride);
+                interleave(first, n, records.data());
+                formatRecords(*asciiCodec, records.data(), stride, n, out);
+            });
+            finishFile(file, options, cloudStats, makeHeader);
+            return;
+        }
+        if (quantizedCodec) {
+            file.writeAt(text.data(), text.size(), 0);
+            writeQuantized(file, text.size(), *quantizedCodec, options, [&](size_t first, size_t n, char* buffer) {
+                interleave(first, n, buffer);
+                return static_cast<const char*>(buffer);
+            });
+            finishFile(file, options, cloudStats, makeHeader);
+            return;
+        }
+        file.preallocate(text.size() + vertex_count_ * stride);
+        file.writeAt(text.data(), text.size(), 0);
+        writeRecords(file, text.size(), stride, options, [&](size_t first, size_t n, char* buffer) {
+            interleave(first, n, buffer);
+            swapper.apply(buffer, n);
+            return static_cast<const char*>(buffer);
+        });
+        finishFile(file, options, cloudStats, makeHeader);
+    }
+
+    // 写入 PLY 文件：预分配最终长度后多线程按位置写入，转换（去填充、字节序）在各线程内完成
+    template<typename VertexType>
+    void write(const std::vector<VertexType>& vertices, const PlyWriteOptions& options = PlyWriteOptions()) {
+        write(vertices, PlyFaceList(), options);
+    }
+
+    // 写入顶点和面片：面片元素为 property list uchar int vertex_indices，
+    // 有超过 255 个顶点的面时个数类型改为 uint。每个面的位置由 CSR 偏移直接算出，可以并行写入
+    template<typename VertexType>
+    void write(const std::vector<VertexType>& vertices, const PlyFaceList& faces,
+               const PlyWriteOptions& options = PlyWriteOptions()) {
+        checkFaces(faces, vertices.size());
+        vertex_count_ = vertices.size();
+        const std::vector<PlyProperty> members = vertexLayout<VertexType>();
+        const std::vector<PlyProperty> layout = packedLayout(members);
+        const size_t stride = layoutSize(layout);
+        const bool swap = options.littleEndian != isLittleEndian();
+        // 无填充的结构体在编译期就确定走整体拷贝
+        const ConversionPlan plan = PlySchema<VertexType>::isPacked
+                                        ? ConversionPlan::identity(layout, stride, swap)
+                                        : ConversionPlan::compile(members, sizeof(VertexType), isLittleEndian(),
+                                                                  layout, stride, options.littleEndian);
+
+        // 按空间顺序写出时先算出顺序，面片下标改为写出后的位置
+        const char* source = reinterpret_cast<const char*>(vertices.data());
+        PlyUninitializedVector<uint64_t> order;
+        PlyFaceList reorderedFaces;
+        const PlyFaceList& outFaces = options.order == PlySpatialOrder::kNone || faces.size() == 0 ? faces : reorderedFaces;
+        if (options.order != PlySpatialOrder::kNone) {
+            PlyStatsScope scope(options.stats ? options.stats : stats_, PlyIOStats::kConvert);
+            order = spatialOrder(source, vertex_count_, positionPlan(members, sizeof(VertexType)), options.order, options.threads);
+            if (faces.size() > 0) {
+                std::vector<uint32_t> position(vertex_count_);
+                for (size_t i = 0; i < vertex_count_; i++) position[order[i]] = static_cast<uint32_t>(i);
+                reorderedFaces.offsets = faces.offsets;
+                reorderedFaces.indices.resize(faces.indices.size());
+                for (size_t k = 0; k < faces.indices.size(); k++) reorderedFaces.indices[k] = position[faces.indices[k]];
+            }
+        }
+        // 写出顺序中第 first 起的 n 个顶点：重新排序时按 order 收集到 scratch（至少 n 个顶点大小），否则直接指向 vertices
+        auto vertexBlock = [&](size_t first, size_t n, char* scratch) {
+            if (order.empty()) return source + first * sizeof(VertexType);
+            for (size_t i = 0; i < n; i++) {
+                std::memcpy(scratch + i * sizeof(VertexType), source + order[first + i] * sizeof(VertexType), sizeof(VertexType));
+            }
+            return static_cast<const char*>(scratch);
+        };
+
+        const size_t faceCount = faces.size();
+        size_t maxItems = 0;
+        for (size_t i = 0; i < faceCount; i++) maxItems = std::max<size_t>(maxItems, faces.offsets[i + 1] - faces.offsets[i]);
+        const PropertyType countType = maxItems > std::numeric_limits<uint8_t>::max() ? PropertyType::UINT : PropertyType::UCHAR;
+        const size_t countSize = propertyTypeSize(countType);
+        std::string faceHeader;
+        if (faceCount > 0) {
+            faceHeader = "element face " + std::to_string(faceCount) + "\nproperty list " +
+                         propertyTypeName(countType) + " int vertex_indices\n";
+        }
+
+        // 写入头部，包围盒写入头部时先写定宽的占位
+        PlyIOStats* stats = options.stats ? options.stats : stats_;
+        PlyCloudStats headerStats;
+        PlyCloudStats* cloudStats = cloudStatsFor(options, headerStats);
+        std::unique_ptr<const PlyStatsCollector> collector;
+        if (cloudStats) collector = std::make_unique<const PlyStatsCollector>(members, sizeof(VertexType), isLittleEndian(), *cloudStats);
+        auto makeHeader = [&](const PlyBounds* bounds) {
+            PlyStatsScope scope(stats, PlyIOStats::kHeader);
+            std::ostringstream header;
+            writeHeader<VertexType>(header, options, faceHeader, bounds);
+            return header.str();
+        };
+        const PlyBounds placeholder;
+        const std::string text = makeHeader(options.boundsInHeader ? &placeholder : nullptr);
+        // 先检查选项、建好编码器再打开输出，被拒绝的调用不会截断已有的文件
+        if ((options.ascii || options.quantization > 0) && options.chunkIndexVertices > 0) {
+            throw std::invalid_argument("Chunk index is only written for uncompressed binary PLY: " + filename_);
+        }
+        if (!options.ascii && options.quantization > 0 && faceCount > 0) {
+            throw std::invalid_argument("Quantized PLY does not support faces: " + filename_);
+        }
+        std::unique_ptr<const PlyAsciiCodec> asciiCodec;
+        std::unique_ptr<const PlyQuantizedCodec> quantizedCodec;
+        if (options.ascii) {
+            asciiCodec = std::make_unique<const PlyAsciiCodec>(members);
+        } else if (options.quantization > 0) {
+            quantizedCodec = std::make_unique<const PlyQuantizedCodec>(members, sizeof(VertexType));
+        }
+
+        PlyOutputFile file(filename_, stats);
+        if (asciiCodec) {
+            file.writeAt(text.data(), text.size(), 0);
+            writeAscii(file, text.size(), sizeof(VertexType), vertexBlock, *asciiCodec, outFaces, options.threads, collector.get());
+            finishFile(file, options, cloudStats, makeHeader);
+            return;
+        }
+        if (quantizedCodec) {
+            file.writeAt(text.data(), text.size(), 0);
+            writeQuantized(file, text.size(), *quantizedCodec, options, [&](size_t first, size_t n, char* buffer) {
+                const char* block = vertexBlock(first, n, buffer);
+                if (collector) collector->add(block, n);
+                return block;
+            });
+            finishFile(file, options, cloudStats, makeHeader);
+            return;
+        }
+        const size_t faceOffset = text.size() + vertex_count_ * stride;
+        const size_t indexCount = faceCount > 0 ? faces.offsets[faceCount] : 0;
+        const size_t fileSize = faceOffset + faceCount * countSize + indexCount * sizeof(int32_t);
+        file.preallocate(fileSize);
+        file.writeAt(text.data(), text.size(), 0);
+
+        // 写入顶点数据：布局和字节序一致时直接从 vertices 写出；重新排序且布局一致时直接收集到 buffer
+        writeRecords(file, text.size(), stride, options, [&](size_t first, size_t n, char* buffer) {
+            PlyUninitializedVector<char> gathered(order.empty() || plan.isIdentity() ? 0 : n * sizeof(VertexType));
+            const char* block = vertexBlock(first, n, gathered.empty() ? buffer : gathered.data());
+            if (collector) collector->add(block, n);
+            if (block == buffer) {
+                plan.swapInPlace(buffer, n);
+                return block;
+            }
+            if (plan.isIdentity() && !plan.needsSwap()) return block;
+            plan.apply(block, n, buffer);
+            return static_cast<const char*>(buffer);
+        });
+        std::vector<PlyBounds> chunkBounds;
+        if (options.chunkIndexVertices > 0) {
+            chunkBounds = computeChunkBounds(options.chunkIndexVertices, members, sizeof(VertexType), vertexBlock, options.threads);
+        }
+
+        // 写入面片数据：第 i 个面位于 faceOffset + i * countSize + offsets[i] * 4
+        const size_t block = PlyReader::kBlockVertices;
+        parallelFor((faceCount + block - 1) / block, [&](size_t begin, size_t end, size_t) {
+            PlyUninitializedVector<char> buffer;
+            for (size_t b = begin; b < end; b++) {
+                const size_t first = b * block;
+                const size_t last = std::min(faceCount, first + block);
+                {
+                    PlyStatsScope scope(stats, PlyIOStats::kConvert);
+                    buffer.resize((last - first) * countSize + (faces.offsets[last] - faces.offsets[first]) * sizeof(int32_t));
+                    char* out = buffer.data();
+                    for (size_t i = first; i < last; i++) {
+                        const uint32_t n = static_cast<uint32_t>(faces.offsets[i + 1] - faces.offsets[i]);
+                        if (countSize == 1) {
+                            *out = static_cast<char>(n);
+                        } else {
+                            const uint32_t value = swap ? swapEndian(n) : n;
+                            std::memcpy(out, &value, sizeof(value));
+                        }
+                        out += countSize;
+                        for (size_t k = faces.offsets[i]; k < faces.offsets[i + 1]; k++) {
+                            const int32_t index = static_cast<int32_t>(outFaces.indices[k]);
+                            const int32_t value = swap ? swapEndian(index) : index;
+                            std::memcpy(out, &value, sizeof(value));
+                            out += sizeof(value);
+                        }
+                    }
+                }
+                file.writeAt(buffer.data(), buffer.size(), faceOffset + first * countSize + faces.offsets[first] * sizeof(int32_t));
+            }
+        }, options.threads);
+        finishFile(file, options, cloudStats, makeHeader);
+        // 索引记录的是写完的文件，关闭后再保存
+        if (options.chunkIndexVertices > 0) {
+            PlyChunkIndex::fromBounds(filename_, options.chunkIndexVertices, vertex_count_, std::move(chunkBounds))
+                .save(PlyChunkIndex::sidecarPath(filename_));
+        }
+    }
+
+private:
+    std::string filename_;
+    size_t vertex_count_ = 0;
+    PlyIOStats* stats_ = nullptr;
+
+    // 面片来自调用方，打开文件前检查：偏移从 0 起不减且止于 indices.size()，下标指向已有顶点且能写成 int
+    // 重新排序时按下标换算位置，越界的下标会读到数组之外
+    void checkFaces(const PlyFaceList& faces, size_t vertexCount) const {
+        if (faces.offsets.empty()) return;
+        if (faces.offsets.front() != 0 || faces.offsets.back() != faces.indices.size() ||
+            !std::is_sorted(faces.offsets.begin(), faces.offsets.end())) {
+            throw std::invalid_argument("Malformed face offsets: " + filename_);
+        }
+        const uint64_t limit = std::min<uint64_t>(vertexCount, uint64_t(std::numeric_limits<int32_t>::max()) + 1);
+        for (uint32_t index : faces.indices) {
+            if (index >= limit) {
+                throw std::out_of_range("Face index " + std::to_string(index) + " is out of range for " +
+                                        std::to_string(vertexCount) + " vertices: " + filename_);
+            }
+        }
+    }
+
+    // 按格式读取全部顶点；reserve(count) 返回能容纳 count 个顶点的目标内存，在确认文件完整后才调用
+    // 文件只映射、头部只解析一次，二进制文件交给沿用二者的 PlyReader；cloudStats 非空时顺带统计
+    template<typename VertexType, typename Reserve>
+    size_t readTo(Reserve&& reserve, PlyCloudStats* cloudStats = nullptr) {
+        auto mapping = std::make_shared<const MappedFile>(filename_, stats_);
+        PlyHeader header;
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kHeader);
+            header = parseHeader(mapping->data(), mapping->size());
+        }
+        if (!header.isBinary) {
+            vertex_count_ = header.vertexCount;
+            readAscii<VertexType>(*mapping, header, reserve, cloudStats);
+            return vertex_count_;
+        }
+        if (header.quantized) {
+            vertex_count_ = header.vertexCount;
+            readQuantized<VertexType>(*mapping, header, reserve, cloudStats);
+            return vertex_count_;
+        }
+        const PlyReader reader(filename_, std::move(mapping), std::move(header), stats_);
+        vertex_count_ = reader.vertexCount();
+        VertexType* vertices = static_cast<VertexType*>(reserve(vertex_count_));
+        if (cloudStats) {
+            reader.read(vertices, *cloudStats);
+        } else {
+            reader.read(vertices);
+        }
+        return vertex_count_;
+    }
+
+    // 读取 ASCII PLY 的顶点：文本按换行切块，先并行数行数确定每块对应的顶点序号，
+    // 再并行解析成文件布局的记录（系统字节序），按块经转换计划写入 vertices
+    template<typename VertexType, typename Reserve>
+    void readAscii(const MappedFile& mapping, const PlyHeader& header, Reserve& reserve, PlyCloudStats* cloudStats) const {
+        const char* data = mapping.data();
+        const size_t size = mapping.size();
+        const PlyAsciiCodec codec(header.properties);
+        const size_t stride = header.vertexSize();
+        const ConversionPlan plan = ConversionPlan::compile(header.properties, stride, isLittleEndian(),
+                                                            vertexLayout<VertexType>(), sizeof(VertexType), isLittleEndian());
+        std::unique_ptr<const PlyStatsCollector> collector;
+        if (cloudStats) collector = std::make_unique<const PlyStatsCollector>(header.properties, stride, isLittleEndian(), *cloudStats);
+
+        // vertex 之前的元素每条记录占一行，顺序跳过
+        size_t start = header.headerSize;
+        for (const auto& element : header.elements) {
+            if (element.name == "vertex") break;
+            for (size_t i = 0; i < element.count; i++) {
+                const void* newline = start < size ? std::memchr(data + start, '\n', size - start) : nullptr;
+                if (!newline) throw std::runtime_error("PLY file is truncated: " + filename_);
+                start = static_cast<const char*>(newline) - data + 1;
+            }
+        }
+
+        // 每块至少 1MB
+        const size_t count = header.vertexCount;
+        const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        const std::vector<size_t> bounds = splitLines(data + start, size - start,
+                                                      std::max<size_t>(1, std::min(threads * 4, (size - start) / (1 << 20))));
+        const size_t chunks = bounds.size() - 1;
+        std::vector<size_t> lineStarts(chunks + 1, 0);
+        if (stats_) stats_->addMapped(size - start);
+        parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            for (size_t c = begin; c < end; c++) lineStarts[c + 1] = countLines(data + start + bounds[c], data + start + bounds[c + 1]);
+        });
+        for (size_t c = 0; c < chunks; c++) lineStarts[c + 1] += lineStarts[c];
+        if (lineStarts[chunks] < count) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+
+        char* out = reinterpret_cast<char*>(static_cast<VertexType*>(reserve(count)));
+        const size_t tile = 4096;
+        parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            PlyUninitializedVector<char> records(tile * stride);
+            for (size_t c = begin; c < end && lineStarts[c] < count; c++) {
+                const char* p = data + start + bounds[c];
+                size_t index = lineStarts[c];
+                const size_t last = std::min(count, lineStarts[c + 1]);
+                while (index < last) {
+                    const size_t n = std::min(tile, last - index);
+                    for (size_t i = 0; i < n; i++) {
+                        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', data + size - p));
+                        if (!lineEnd) lineEnd = data + size;
+                        if (!codec.parse(p, lineEnd, records.data() + i * stride)) {
+                            throw std::runtime_error("Invalid ASCII PLY vertex " + std::to_string(index + i) + ": " + filename_);
+                        }
+                        p = lineEnd + 1;
+                    }
+                    if (collector) collector->add(records.data(), n);
+                    plan.apply(records.data(), n, out + index * sizeof(VertexType));
+                    index += n;
+                }
+            }
+        });
+    }
+
+    // 量化压缩的顶点数据：块数 uint64、块目录（块数 + 1 个起始位置，最后一个为数据结尾）、各块
+    // 每块即 writeBlocks 的一块，各块并行编码；读取时按目录并行解码
+    // fill(first, n, buffer) 与 writeRecords 相同，返回 codec 布局的 n 条记录
+    template<typename Fill>
+    void writeQuantized(PlyOutputFile& file, size_t offset, const PlyQuantizedCodec& codec,
+                        const PlyWriteOptions& options, Fill&& fill) const {
+        const size_t block = PlyReader::kBlockVertices;
+        const uint64_t chunks = (vertex_count_ + block - 1) / block;
+        std::vector<uint64_t> directory;
+        directory.reserve(chunks + 1);
+        const size_t dataOffset = offset + sizeof(uint64_t) * (chunks + 2);
+        const size_t stride = codec.stride();
+        const size_t end = writeBlocks(file, dataOffset, vertex_count_, options.threads, [&](size_t first, size_t n, std::string& out) {
+            PlyUninitializedVector<char> buffer(n * stride);
+            codec.encode(fill(first, n, buffer.data()), n, options.quantization, out);
+        }, &directory);
+        directory.push_back(end);
+        file.writeAt(reinterpret_cast<const char*>(&chunks), sizeof(chunks), offset);
+        file.writeAt(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(uint64_t), offset + sizeof(chunks));
+    }
+
+    // 读取量化压缩的顶点：各块并行解码成文件布局的记录，再按转换计划写入 vertices
+    template<typename VertexType, typename Reserve>
+    void readQuantized(const MappedFile& mapping, const PlyHeader& header, Reserve& reserve, PlyCloudStats* cloudStats) const {
+        const char* data = mapping.data();
+        const size_t size = mapping.size();
+        const size_t stride = header.vertexSize();
+        const PlyQuantizedCodec codec(header.properties, stride);
+        const ConversionPlan plan = ConversionPlan::compile(header.properties, stride, isLittleEndian(),
+                                                            vertexLayout<VertexType>(), sizeof(VertexType), isLittleEndian());
+        std::unique_ptr<const PlyStatsCollector> collector;
+        if (cloudStats) collector = std::make_unique<const PlyStatsCollector>(header.properties, stride, isLittleEndian(), *cloudStats);
+
+        const size_t block = PlyReader::kBlockVertices;
+        const size_t count = header.vertexCount;
+        const uint64_t chunks = (count + block - 1) / block;
+        uint64_t stored = 0;
+        if (header.headerSize + sizeof(stored) * (chunks + 2) > size) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+        std::memcpy(&stored, data + header.headerSize, sizeof(stored));
+        if (stored != chunks) {
+            throw std::runtime_error("Quantized PLY chunk count does not match vertex count: " + filename_);
+        }
+        std::vector<uint64_t> directory(chunks + 1);
+        std::memcpy(directory.data(), data + header.headerSize + sizeof(stored), directory.size() * sizeof(uint64_t));
+        if (directory.back() > size) {
+            throw std::runtime_error("PLY file is truncated: " + filename_);
+        }
+
+        if (stats_) stats_->addMapped(directory.back() - header.headerSize);
+        char* out = reinterpret_cast<char*>(static_cast<VertexType*>(reserve(count)));
+        parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+            PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+            PlyUninitializedVector<char> records(block * stride);
+            for (size_t c = begin; c < end; c++) {
+                const size_t n = std::min(block, count - c * block);
+                if (directory[c] > directory[c + 1] ||
+                    PlyQuantizedCodec::chunkCount(data + directory[c], directory[c + 1] - directory[c]) != n) {
+                    throw std::runtime_error("Quantized PLY chunk is corrupt: " + filename_);
+                }
+                codec.decode(data + directory[c], directory[c + 1] - directory[c], records.data());
+                if (collector) collector->add(records.data(), n);
+                plan.apply(records.data(), n, out + c * block * sizeof(VertexType));
+            }
+        });
+    }
+
+    // 以 ASCII 写出顶点（每条 stride 字节，按 codec 的布局格式化）和面片；collector 非空时顺带统计顶点
+    // block(first, n, scratch) 返回写出顺序中第 first 起的 n 条记录，可以收集到 scratch（n * stride 字节）
+    template<typename Block>
+    void writeAscii(PlyOutputFile& file, size_t offset, size_t stride, Block&& block, const PlyAsciiCodec& codec,
+                    const PlyFaceList& faces, size_t threads, const PlyStatsCollector* collector = nullptr) const {
+        offset = writeBlocks(file, offset, vertex_count_, threads, [&](size_t first, size_t n, std::string& out) {
+            PlyUninitializedVector<char> scratch(n * stride);
+            const char* records = block(first, n, scratch.data());
+            if (collector) collector->add(records, n);
+            formatRecords(codec, records, stride, n, out);
+        });
+        const size_t countChars = PlyAsciiCodec::maxChars(PropertyType::UINT) + 1;
+        const size_t indexChars = PlyAsciiCodec::maxChars(PropertyType::INT) + 1;
+        writeBlocks(file, offset, faces.size(), threads, [&](size_t first, size_t n, std::string& out) {
+            out.resize(n * countChars + (faces.offsets[first + n] - faces.offsets[first]) * indexChars);
+            char* p = &out[0];
+            for (size_t i = first; i < first + n; i++) {
+                p = std::to_chars(p, p + countChars, faces.offsets[i + 1] - faces.offsets[i]).ptr;
+                for (size_t k = faces.offsets[i]; k < faces.offsets[i + 1]; k++) {
+                    *p++ = ' ';
+                    p = std::to_chars(p, p + indexChars, static_cast<int32_t>(faces.indices[k])).ptr;
+                }
+                *p++ = '\n';
+            }
+            out.resize(p - out.data());
+        });
+    }
+
+    static void formatRecords(const PlyAsciiCodec& codec, const char* records, size_t stride, size_t count, std::string& out) {
+        out.resize(count * codec.maxLength());
+        char* p = &out[0];
+        for (size_t i = 0; i < count; i++) p = codec.format(records + i * stride, p);
+        out.resize(p - out.data());
+    }
+
+    // 按写出顺序逐块计算包围盒，供 PlyChunkIndex 使用；block 同 write 中的 vertexBlock
+    template<typename Block>
+    std::vector<PlyBounds> computeChunkBounds(size_t chunkVertices, const std::vector<PlyProperty>& members, size_t vertexSize,
+                                              Block&& block, size_t threads) const {
+        const ConversionPlan plan = positionPlan(members, vertexSize);
+        const size_t chunks = (vertex_count_ + chunkVertices - 1) / chunkVertices;
+        std::vector<PlyBounds> bounds(chunks);
+        parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+            PlyUninitializedVector<char> scratch(chunkVertices * vertexSize);
+            std::vector<PlyPosition> positions(chunkVertices);
+            for (size_t c = begin; c < end; c++) {
+                const size_t first = c * chunkVertices;
+                const size_t n = std::min(chunkVertices, vertex_count_ - first);
+                plan.apply(block(first, n, scratch.data()), n, reinterpret_cast<char*>(positions.data()));
+                for (size_t i = 0; i < n; i++) bounds[c].expand(positions[i]);
+            }
+        }, threads);
+        return bounds;
+    }
+
+    // 写入时的统计目标：调用方给出 options.cloudStats 时用它，只要求把包围盒写入头部时用 local，否则不统计
+    static PlyCloudStats* cloudStatsFor(const PlyWriteOptions& options, PlyCloudStats& local) {
+        if (options.cloudStats) return options.cloudStats;
+        return options.boundsInHeader ? &local : nullptr;
+    }
+
+    // 数据写完后关闭文件；包围盒写入头部时用统计结果重新生成头部，覆盖开头定宽的占位（长度不变）
+    template<typename MakeHeader>
+    static void finishFile(PlyOutputFile& file, const PlyWriteOptions& options, const PlyCloudStats* cloudStats,
+                           MakeHeader&& makeHeader) {
+        if (options.boundsInHeader) {
+            const std::string text = makeHeader(&cloudStats->bounds);
+            file.writeAt(text.data(), text.size(), 0);
+        }
+        file.close();
+    }
+
+    // 从 offset 开始写出 count 条变长记录（文本、压缩块），返回写完后的位置；blockOffsets 非空时记录每块的起始位置
+    // 长度事先未知：每轮并行格式化若干块（format(first, n, out)），再按顺序写出，内存占用与文件大小无关
+    template<typename Format>
+    size_t writeBlocks(PlyOutputFile& file, size_t offset, size_t count, size_t threads, Format&& format,
+                       std::vector<uint64_t>* blockOffsets = nullptr) const {
+        const size_t block = PlyReader::kBlockVertices;
+        const size_t blocks = (count + block - 1) / block;
+        const size_t round = 2 * std::max<size_t>(1, threads ? threads : std::thread::hardware_concurrency());
+        std::vector<std::string> buffers(std::min(round, blocks));
+        for (size_t firstBlock = 0; firstBlock < blocks; firstBlock += round) {
+            const size_t n = std::min(round, blocks - firstBlock);
+            parallelFor(n, [&](size_t begin, size_t end, size_t) {
+                PlyStatsScope scope(file.stats(), PlyIOStats::kConvert);
+                for (size_t b = begin; b < end; b++) {
+                    const size_t first = (firstBlock + b) * block;
+                    format(first, std::min(block, count - first), buffers[b]);
+                }
+            }, threads);
+            for (size_t b = 0; b < n; b++) {
+                if (blockOffsets) blockOffsets->push_back(offset);
+                file.writeAt(buffers[b].data(), buffers[b].size(), offset);
+                offset += buffers[b].size();
+            }
+        }
+        return offset;
+    }
+
+    // 从 base 开始按块并行写入 vertex_count_ 条记录，文件需已预分配
+    // fill(first, n, buffer) 返回这 n 条记录的文件字节，可以是 buffer 也可以是已有内存
+    template<typename Fill>
+    void writeRecords(PlyOutputFile& file, size_t base, size_t stride, const PlyWriteOptions& options, Fill&& fill) {
+        const size_t block = PlyReader::kBlockVertices;
+        const size_t blocks = (vertex_count_ + block - 1) / block;
+        parallelFor(blocks, [&](size_t begin, size_t end, size_t) {
+            PlyUninitializedVector<char> buffer(block * stride);
+            for (size_t b = begin; b < end; b++) {
+                const size_t first = b * block;
+                const size_t n = std::min(block, vertex_count_ - first);
+                const char* bytes;
+                {
+                    PlyStatsScope scope(file.stats(), PlyIOStats::kConvert);
+                    bytes = fill(first, n, buffer.data());
+                }
+                file.writeAt(bytes, n * stride, base + first * stride);
+            }
+        }, options.threads);
+    }
+
+    // 写入头部
+    template<typename VertexType>
+    void writeHeader(std::ostream& file, const PlyWriteOptions& options, const std::string& extraElements = std::string(),
+                     const PlyBounds* bounds = nullptr) const {
+        file << "ply\n";
+        writePlyFormat(file, options);
+        if (bounds) file << plyBoundsInfo(*bounds);
+        file << "element vertex " << vertex_count_ << "\n";
+        
+        file << PlySchema<VertexType>::properties();
+
+        file << extraElements;
+        file << "end_header\n";
+    }
+
+    // 按属性列表写入头部
+    void writeHeader(std::ostream& file, const std::vector<PlyProperty>& layout, const PlyWriteOptions& options,
+                     const PlyBounds* bounds = nullptr) const {
+        writePlyHeader(file, layout, std::to_string(vertex_count_), options, std::string(), bounds);
+    }
+};
+
+// 批量读取大量小文件（例如上万个城市瓦片），按文件顺序拼接到一个数组
+// 第一遍并行读取各文件头部得到顶点数和每个文件的起始下标，第二遍各线程动态领取文件，直接读入数组中属于它的区间
+// 属性布局和字节序相同的文件共用一份转换计划，缓存在读取器中，多次 read 之间保留
+// vertex 元素带列表属性的文件不支持，读取头部时即抛出异常
+template<typename VertexType>
+class PlyBatchReader {
+public:
+    explicit PlyBatchReader(PlyIOStats* stats = nullptr) : stats_(stats) {}
+
+    // 读取 paths 中的全部文件；offsets 共 paths.size() + 1 项，第 i 个文件的顶点为 vertices[offsets[i], offsets[i + 1])
+    template<typename Allocator>
+    void read(const std::vector<std::string>& paths, std::vector<VertexType, Allocator>& vertices,
+              std::vector<uint64_t>& offsets, size_t threads = 0) {
+        std::vector<PlyHeader> headers(paths.size());
+        parallelForDynamic(paths.size(), [&](size_t i, size_t) {
+            headers[i] = PlyReader::readHeader(paths[i], stats_);
+            // 顶点记录不定长，无法按位置读取，在读入任何数据前拒绝
+            const PlyElement* element = headers[i].findElement("vertex");
+            if (element && element->hasList()) {
+                throw std::runtime_error("PLY vertex element has list properties: " + paths[i]);
+            }
+        }, threads);
+        offsets.assign(paths.size() + 1, 0);
+        for (size_t i = 0; i < paths.size(); i++) offsets[i + 1] = offsets[i] + headers[i].vertexCount;
+        {
+            PlyStatsScope scope(stats_, PlyIOStats::kAllocate);
+            vertices.resize(offsets.back());
+        }
+        VertexType* out = vertices.data();
+        parallelForDynamic(paths.size(), [&](size_t i, size_t) {
+            readFile(paths[i], headers[i], out + offsets[i]);
+        }, threads);
+    }
+
+    // 已缓存的转换计划个数（即遇到的不同顶点布局数）
+    size_t cachedPlans() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return plans_.size();
+    }
+
+private:
+    // 定长的二进制顶点数据直接按位置读入 out，其余情况（ASCII、量化、vertex 前有变长元素）交给通用的读取
+    void readFile(const std::string& path, const PlyHeader& header, VertexType* out) {
+        const size_t count = header.vertexCount;
+        const PlyElement* element = header.findElement("vertex");
+        if (!header.isBinary || header.quantized) {
+            PlyBinaryIO io(path);
+            io.setStats(stats_);
+            checkCount(path, count, io.read(out, count));
+            return;
+        }
+        if (element && element->offset == PlyElement::npos) {
+            const PlyReader reader(path, stats_);
+            checkCount(path, count, reader.vertexCount());
+            reader.read(out, 1);
+            return;
+        }
+        if (count == 0) return;
+
+        const ConversionPlan& plan = planFor(header);
+        const size_t stride = plan.srcStride();
+        char* dst = reinterpret_cast<char*>(out);
+        const int fd = PlyReader::openFile(path, stats_);
+        try {
+            if (plan.isIdentity()) {
+                readExact(fd, path, dst, count * stride, header.dataOffset);
+                PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                plan.swapInPlace(dst, count);
+            } else {
+                const size_t block = PlyReader::kBlockVertices;
+                PlyUninitializedVector<char> raw(std::min(count, block) * stride);
+                for (size_t done = 0; done < count; done += block) {
+                    const size_t n = std::min(block, count - done);
+                    readExact(fd, path, raw.data(), n * stride, header.dataOffset + done * stride);
+                    PlyStatsScope scope(stats_, PlyIOStats::kConvert);
+                    plan.apply(raw.data(), n, dst + done * sizeof(VertexType));
+                }
+            }
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (stats_) stats_->addCalls(1);
+    }
+
+    void readExact(int fd, const std::string& path, char* buffer, size_t size, size_t offset) const {
+        if (PlyReader::readAt(fd, path, stats_, buffer, size, offset) != size) {
+            throw std::runtime_error("PLY file is truncated: " + path);
+        }
+    }
+
+    static void checkCount(const std::string& path, size_t expected, size_t actual) {
+        if (expected != actual) {
+            throw std::runtime_error("PLY file changed while reading: " + path);
+        }
+    }
+
+    // 按顶点属性（名称、类型）和字节序查找转换计划，第一次遇到时编译
+    const ConversionPlan& planFor(const PlyHeader& header) {
+        std::string key = header.littleEndian ? "<" : ">";
+        for (const auto& property : header.properties) {
+            key += property.name + ' ' + propertyTypeName(property.type) + '\n';
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = plans_.find(key);
+        if (found == plans_.end()) {
+            found = plans_.emplace(std::move(key), ConversionPlan::compile<VertexType>(header)).first;
+        }
+        return found->second;
+    }
+
+    PlyIOStats* stats_;
+    mutable std::mutex mutex_;
+    std::map<std::string, ConversionPlan> plans_;  // 节点地址稳定，返回的引用一直有效
+};
+
+// 追加写入器：用于实时采集，顶点分批到达
+// 头部中的顶点数预留为固定宽度，每次数据落盘后回填已写入的数量，异常退出时文件仍然可读
+// options.boundsInHeader 时包围盒行同样定宽，随顶点数一起回填
+// 两块缓冲轮换：一块在后台线程写盘时，调用方继续填充另一块
+template<typename VertexType>
+class PlyAppendWriter {
+public:
+    static constexpr size_t kCountWidth = 20;  // 足够容纳 size_t 的十进制位数
+
+    explicit PlyAppendWriter(const std::string& filename, const PlyWriteOptions& options = PlyWriteOptions(),
+                             size_t bufferVertices = 1 << 20)
+        : file_(validated(filename, options), options.stats), members_(vertexLayout<VertexType>()), layout_(packedLayout(members_)),
+          stride_(layoutSize(layout_)), capacity_(std::max<size_t>(1, bufferVertices)),
+          plan_(PlySchema<VertexType>::isPacked
+                    ? ConversionPlan::identity(layout_, stride_, options.littleEndian != isLittleEndian())
+                    : ConversionPlan::compile(members_, sizeof(VertexType), isLittleEndian(), layout_, stride_, options.littleEndian)),
+          boundsInHeader_(options.boundsInHeader) {
+        std::ostringstream header;
+        PlyCloudStats* cloudStats = options.cloudStats ? options.cloudStats : options.boundsInHeader ? &localStats_ : nullptr;
+        if (cloudStats) {
+            cloudStats_ = cloudStats;
+            collector_ = std::make_unique<const PlyStatsCollector>(members_, sizeof(VertexType), isLittleEndian(), *cloudStats);
+        }
+        const PlyBounds placeholder;
+        writePlyHeader(header, layout_, std::string(kCountWidth, '0'), options, std::string(),
+                       boundsInHeader_ ? &placeholder : nullptr);
+        const std::string text = header.str();
+        boundsOffset_ = text.find("obj_info bbox ");
+        countOffset_ = text.find("element vertex ") + std::strlen("element vertex ");
+        dataOffset_ = text.size();
+        file_.writeAt(text.data(), text.size(), 0);
+        for (auto& buffer : buffers_) buffer.resize(capacity_ * stride_);
+    }
+
+    ~PlyAppendWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+    PlyAppendWriter(const PlyAppendWriter&) = delete;
+    PlyAppendWriter& operator=(const PlyAppendWriter&) = delete;
+
+    void append(const VertexType* vertices, size_t count) {
+        if (closed_) {
+            throw std::logic_error("PlyAppendWriter is closed");
+        }
+        while (count > 0) {
+            const size_t n = std::min(count, capacity_ - buffered_);
+            {
+                PlyStatsScope scope(file_.stats(), PlyIOStats::kConvert);
+                if (collector_) collector_->add(reinterpret_cast<const char*>(vertices), n);
+                plan_.apply(reinterpret_cast<const char*>(vertices), n, buffers_[active_].data() + buffered_ * stride_);
+            }
+            buffered_ += n;
+            vertices += n;
+            count -= n;
+            if (buffered_ == capacity_) submit();
+        }
+    }
+
+    void append(const std::vector<VertexType>& vertices) { append(vertices.data(), vertices.size()); }
+
+    // 把已缓冲的顶点写盘并回填数量
+    void flush() {
+        if (buffered_ > 0) submit();
+        wait();
+    }
+
+    void close() {
+        if (closed_) return;
+        flush();
+        closed_ = true;
+        file_.close();
+    }
+
+    // 已追加的顶点数（包括尚未落盘的）
+    size_t count() const { return written_ + buffered_; }
+
+private:
+    // 在成员初始化中先于打开（截断）文件检查选项，被拒绝时不动已有的文件
+    static const std::string& validated(const std::string& filename, const PlyWriteOptions& options) {
+        if (options.ascii || options.quantization > 0) {
+            throw std::invalid_argument("PlyAppendWriter only writes uncompressed binary PLY: " + filename);
+        }
+        if (options.order != PlySpatialOrder::kNone || options.chunkIndexVertices > 0) {
+            throw std::invalid_argument("PlyAppendWriter keeps the arrival order and writes no chunk index: " + filename);
+        }
+        return filename;
+    }
+
+    // 把当前缓冲交给后台线程写盘，切换到另一块缓冲
+    void submit() {
+        wait();
+        const char* data = buffers_[active_].data();
+        const size_t offset = dataOffset_ + written_ * stride_;
+        const size_t bytes = buffered_ * stride_;
+        written_ += buffered_;
+        const size_t total = written_;
+        // 此时已追加的顶点都已统计，包围盒与 total 对应
+        const std::string bounds = boundsInHeader_ ? plyBoundsInfo(cloudStats_->bounds) : std::string();
+        pending_ = std::async(std::launch::async, [this, data, offset, bytes, total, bounds]() {
+            file_.writeAt(data, bytes, offset);
+            if (!bounds.empty()) file_.writeAt(bounds.data(), bounds.size(), boundsOffset_);
+            patchCount(total);
+        });
+        active_ ^= 1;
+        buffered_ = 0;
+    }
+
+    void wait() {
+        if (pending_.valid()) pending_.get();
+    }
+
+    void patchCount(size_t count) {
+        std::string digits = std::to_string(count);
+        digits.insert(0, kCountWidth - digits.size(), '0');
+        file_.writeAt(digits.data(), digits.size(), countOffset_);
+    }
+
+    PlyOutputFile file_;
+    std::vector<PlyProperty> members_;
+    std::vector<PlyProperty> layout_;
+    size_t stride_;
+    size_t capacity_;
+    ConversionPlan plan_;
+    size_t countOffset_ = 0;
+    size_t dataOffset_ = 0;
+    bool boundsInHeader_;
+    size_t boundsOffset_ = 0;
+    PlyCloudStats localStats_;
+    PlyCloudStats* cloudStats_ = nullptr;
+    std::unique_ptr<const PlyStatsCollector> collector_;
+
+    std::vector<char> buffers_[2];
+    size_t active_ = 0;
+    size_t buffered_ = 0;  // 当前缓冲中的顶点数
+    size_t written_ = 0;   // 已提交写盘的顶点数
+    std::future<void> pending_;
+    bool closed_ = false;
+};
+
+// 修复追加写入中途退出的文件：按实际数据长度回填顶点数并截掉不完整的尾部记录
+// 头部有 obj_info bbox 行时按保留的数据重新计算包围盒回填（数据可能先于包围盒落盘）
+// 返回修复后的顶点数
+inline size_t recoverAppendedPly(const std::string& filename) {
+    size_t count = 0, countOffset = 0, countWidth = 0, dataEnd = 0, boundsOffset = std::string::npos;
+    std::string bounds;
+    {
+        PlyReader reader(filename);
+        const PlyHeader& header = reader.header();
+        struct stat st;
+        if (::stat(filename.c_str(), &st) != 0) {
+            throw std::runtime_error("Failed to stat file: " + filename);
+        }
+        const size_t stride = header.vertexSize();
+        const size_t payload = static_cast<size_t>(st.st_size) > header.dataOffset ? st.st_size - header.dataOffset : 0;
+        count = stride == 0 ? 0 : payload / stride;
+        dataEnd = header.dataOffset + count * stride;
+
+        // 在头部文本中找到顶点数字段
+        std::vector<char> text(header.headerSize);
+        std::ifstream file(filename, std::ios::binary);
+        file.read(text.data(), text.size());
+        const std::string headerText(text.begin(), text.end());
+        const size_t element = headerText.find("element vertex ");
+        if (element == std::string::npos) {
+            throw std::runtime_error("PLY file has no vertex element: " + filename);
+        }
+        countOffset = element + std::strlen("element vertex ");
+        countWidth = headerText.find_first_not_of("0123456789", countOffset) - countOffset;
+
+        if (header.hasBounds) {
+            PlyCloudStats cloudStats;
+            const PlyStatsCollector collector(header.properties, stride, header.littleEndian, cloudStats);
+            const MappedFile mapping(filename);
+            if (count > 0) collector.add(mapping.data() + header.dataOffset, count);
+            bounds = plyBoundsInfo(cloudStats.bounds);
+            boundsOffset = headerText.find("obj_info bbox ");
+            if (headerText.find('\n', boundsOffset) + 1 - boundsOffset != bounds.size()) {
+                throw std::runtime_error("Bounding box line is not fixed width, cannot patch: " + filename);
+            }
+        }
+    }
+
+    std::string digits = std::to_string(count);
+    if (digits.size() > countWidth) {
+        throw std::runtime_error("Vertex count field is too narrow to patch: " + filename);
+    }
+    digits.insert(0, countWidth - digits.size(), '0');
+    int fd = ::open(filename.c_str(), O_WRONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file for writing: " + filename);
+    }
+    const bool ok = ::pwrite(fd, digits.data(), digits.size(), static_cast<off_t>(countOffset)) == static_cast<ssize_t>(digits.size()) &&
+                    (bounds.empty() || ::pwrite(fd, bounds.data(), bounds.size(), static_cast<off_t>(boundsOffset)) ==
+                                           static_cast<ssize_t>(bounds.size())) &&
+                    ::ftruncate(fd, static_cast<off_t>(dataEnd)) == 0;
+    ::close(fd);
+    if (!ok) {
+        throw std::runtime_error("Failed to patch file: " + filename);
+    }
+    return count;
+}
+
+// 不解码的合并、拆分、裁剪：属性布局和字节序相同时只改写头部，顶点数据按字节区间在文件间复制
+// 只处理二进制（未压缩）且 vertex 没有列表属性的文件，输出只保留 vertex 元素（面片引用的下标会失效）
+
+// pread 读满 size 字节，文件不够长时抛出异常
+inline void readFileBytes(int input, const std::string& inputName, PlyIOStats* stats, char* buffer, size_t size, size_t offset) {
+    PlyStatsScope scope(stats, PlyIOStats::kIO);
+    size_t done = 0, calls = 0;
+    while (done < size) {
+        const ssize_t got = ::pread(input, buffer + done, size - done, static_cast<off_t>(offset + done));
+        calls++;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to read file: " + inputName);
+        }
+        if (got == 0) {
+            throw std::runtime_error("PLY file is truncated: " + inputName);
+        }
+        done += static_cast<size_t>(got);
+    }
+    if (stats) stats->addRead(done, calls);
+}
+
+// 把 input 中 [inOffset, inOffset + size) 的字节复制到 output 的 outOffset
+// Linux 上优先用 copy_file_range，数据不经过用户态（部分文件系统上直接共享数据块）；
+// 内核或文件系统不支持（旧内核、跨文件系统等）时退回固定大小缓冲区的 pread/pwrite
+inline void copyFileBytes(int input, const std::string& inputName, size_t inOffset, const PlyOutputFile& output,
+                          size_t outOffset, size_t size) {
+    PlyIOStats* stats = output.stats();
+#ifdef __linux__
+    {
+        PlyStatsScope scope(stats, PlyIOStats::kIO);
+        size_t done = 0, calls = 0;
+        while (done < size) {
+            loff_t in = static_cast<loff_t>(inOffset + done), out = static_cast<loff_t>(outOffset + done);
+            const ssize_t copied = ::copy_file_range(input, &in, output.fd(), &out, size - done, 0);
+            calls++;
+            if (copied < 0) {
+                if (errno == EINTR) continue;
+                if (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP) break;
+                throw std::runtime_error("Failed to copy from file: " + inputName);
+            }
+            if (copied == 0) {
+                throw std::runtime_error("PLY file is truncated: " + inputName);
+            }
+            done += static_cast<size_t>(copied);
+        }
+        if (stats) stats->addWrite(done, calls);
+        inOffset += done;
+        outOffset += done;
+        size -= done;
+    }
+#endif
+    PlyUninitializedVector<char> buffer(std::min<size_t>(size, PlyReader::kReadAheadBytes));
+    while (size > 0) {
+        const size_t n = std::min(size, buffer.size());
+        readFileBytes(input, inputName, stats, buffer.data(), n, inOffset);
+        output.writeAt(buffer.data(), n, outOffset);
+        inOffset += n;
+        outOffset += n;
+        size -= n;
+    }
+}
+
+// 读取待复制文件的头部，检查格式，返回顶点数据的起始位置（vertex 前有变长元素时需扫描）
+inline size_t plyVertexDataOffset(const std::string& filename, PlyHeader& header, PlyIOStats* stats) {
+    header = PlyReader::readHeader(filename, stats);
+    if (!header.isBinary || header.quantized) {
+        throw std::runtime_error("Only uncompressed binary PLY can be copied without decoding: " + filename);
+    }
+    const PlyElement* element = header.findElement("vertex");
+    if (element && element->hasList()) {
+        throw std::runtime_error("PLY vertex element has list properties: " + filename);
+    }
+    if (element && element->offset == PlyElement::npos) return PlyReader(filename, stats).header().dataOffset;
+    return header.dataOffset;
+}
+
+// 把 input 中从第 first 个起的 count 个顶点（已定位到 dataOffset、布局为 header）写到 output 的 outOffset
+// plan 为 nullptr 表示布局和字节序与输出一致，直接复制字节；否则按块转换，每块最多 kBlockVertices 个顶点
+inline void copyPlyVertices(const std::string& input, const PlyHeader& header, size_t dataOffset, size_t first, size_t count,
+                            const ConversionPlan* plan, const PlyOutputFile& output, size_t outOffset) {
+    const size_t stride = header.vertexSize();
+    const int fd = ::open(input.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file for reading: " + input);
+    }
+    PlyIOStats* stats = output.stats();
+    if (stats) stats->addCalls(1);
+    try {
+        if (!plan) {
+            copyFileBytes(fd, input, dataOffset + first * stride, output, outOffset, count * stride);
+        } else {
+            const size_t block = std::min(count, PlyReader::kBlockVertices);
+            PlyUninitializedVector<char> raw(block * stride), converted(block * plan->dstStride());
+            for (size_t done = 0; done < count; done += block) {
+                const size_t n = std::min(block, count - done);
+                readFileBytes(fd, input, stats, raw.data(), n * stride, dataOffset + (first + done) * stride);
+                {
+                    PlyStatsScope scope(stats, PlyIOStats::kConvert);
+                    plan->apply(raw.data(), n, converted.data());
+                }
+                output.writeAt(converted.data(), n * plan->dstStride(), outOffset + done * plan->dstStride());
+            }
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (stats) stats->addCalls(1);
+}
+
+// 写出只含 vertex 元素的头部，预分配文件，返回顶点数据的起始位置
+inline size_t beginPlyCopy(PlyOutputFile& output, const PlyHeader& layout, size_t count, const PlyBounds* bounds) {
+    PlyWriteOptions options;
+    options.littleEndian = layout.littleEndian;
+    std::ostringstream header;
+    writePlyHeader(header, layout.properties, std::to_string(count), options, std::string(), bounds);
+    const std::string text = header.str();
+    output.preallocate(text.size() + count * layout.vertexSize());
+    output.writeAt(text.data(), text.size(), 0);
+    return text.size();
+}
+
+// 打开输出会截断文件并删除它的索引，所以先检查输出不是输入之一，输出之间也不重复
+// 已存在的文件按设备号和 inode 比较（不同写法的路径、硬链接也能识别），尚不存在的按路径比较
+inline void checkPlyCopyTargets(const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) {
+    std::set<std::pair<dev_t, ino_t>> files;
+    for (const auto& input : inputs) {
+        struct stat st;
+        if (::stat(input.c_str(), &st) == 0) files.emplace(st.st_dev, st.st_ino);
+    }
+    std::set<std::string> missing;
+    for (const auto& output : outputs) {
+        struct stat st;
+        const bool added = ::stat(output.c_str(), &st) == 0 ? files.emplace(st.st_dev, st.st_ino).second
+                                                           : missing.insert(output).second;
+        if (!added) {
+            throw std::invalid_argument("PLY output would overwrite an input or another output: " + output);
+        }
+    }
+}
+
+// 合并多个文件的顶点到 output，按输入顺序拼接；输出使用第一个文件的属性布局和字节序
+// 布局和字节序相同的文件直接复制字节，其余按块转换（缺少的属性补零）；各文件由线程动态领取，
+// 每个线程只占用一块转换缓冲区，内存与文件大小、文件个数无关。所有输入的头部都有包围盒时输出合并后的包围盒
+// 返回顶点总数
+inline size_t mergePly(const std::vector<std::string>& inputs, const std::string& output, size_t threads = 0,
+                       PlyIOStats* stats = nullptr) {
+    if (inputs.empty()) {
+        throw std::invalid_argument("No PLY files to merge into: " + output);
+    }
+    checkPlyCopyTargets(inputs, {output});
+    std::vector<PlyHeader> headers(inputs.size());
+    std::vector<size_t> dataOffsets(inputs.size());
+    parallelForDynamic(inputs.size(), [&](size_t i, size_t) {
+        dataOffsets[i] = plyVertexDataOffset(inputs[i], headers[i], stats);
+    }, threads);
+
+    const PlyHeader& layout = headers[0];
+    const size_t stride = layout.vertexSize();
+    std::vector<uint64_t> offsets(inputs.size() + 1, 0);
+    PlyBounds bounds;
+    bool hasBounds = true;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        offsets[i + 1] = offsets[i] + headers[i].vertexCount;
+        hasBounds = hasBounds && headers[i].hasBounds;
+        if (headers[i].hasBounds) bounds.expand(headers[i].bounds);
+    }
+
+    PlyOutputFile file(output, stats);
+    const size_t base = beginPlyCopy(file, layout, offsets.back(), hasBounds ? &bounds : nullptr);
+    parallelForDynamic(inputs.size(), [&](size_t i, size_t) {
+        const PlyHeader& header = headers[i];
+        const ConversionPlan plan = ConversionPlan::compile(header.properties, header.vertexSize(), header.littleEndian,
+                                                            layout.properties, stride, layout.littleEndian);
+        const bool copy = plan.isIdentity() && !plan.needsSwap();
+        copyPlyVertices(inputs[i], header, dataOffsets[i], 0, header.vertexCount, copy ? nullptr : &plan, file,
+                        base + offsets[i] * stride);
+    }, threads);
+    file.close();
+    return offsets.back();
+}
+
+// 把 input 中 [first, first + count) 的顶点原样（布局、字节序不变）写到 output
+inline void cropPly(const std::string& input, const std::string& output, size_t first, size_t count,
+                    PlyIOStats* stats = nullptr) {
+    checkPlyCopyTargets({input}, {output});
+    PlyHeader header;
+    const size_t dataOffset = plyVertexDataOffset(input, header, stats);
+    if (first > header.vertexCount || count > header.vertexCount - first) {
+        throw std::out_of_range("PLY vertex range is out of bounds: " + input);
+    }
+    PlyOutputFile file(output, stats);
+    const size_t base = beginPlyCopy(file, header, count, nullptr);
+    copyPlyVertices(input, header, dataOffset, first, count, nullptr, file, base);
+    file.close();
+}
+
+// 把 input 的顶点按顺序均分到 outputs 中的各文件（前 vertexCount % outputs.size() 个文件各多一个），各文件并行写出
+inline void splitPly(const std::string& input, const std::vector<std::string>& outputs, size_t threads = 0,
+                     PlyIOStats* stats = nullptr) {
+    if (outputs.empty()) {
+        throw std::invalid_argument("No output files to split into: " + input);
+    }
+    checkPlyCopyTargets({input}, outputs);
+    PlyHeader header;
+    const size_t dataOffset = plyVertexDataOffset(input, header, stats);
+    const size_t share = header.vertexCount / outputs.size();
+    const size_t extra = header.vertexCount % outputs.size();
+    parallelForDynamic(outputs.size(), [&](size_t i, size_t) {
+        const size_t first = i * share + std::min(i, extra);
+        const size_t count = share + (i < extra ? 1 : 0);
+        PlyOutputFile file(outputs[i], stats);
+        const size_t base = beginPlyCopy(file, header, count, nullptr);
+        copyPlyVertices(input, header, dataOffset, first, count, nullptr, file, base);
+        file.close();
+    }, threads);
+}
+
+// 多分辨率 LOD 八叉树，用于流式显示：先载入粗的层级，再按可见范围逐步载入细节
+// 根节点为包围盒的外接立方体，每个节点是目录中的一个小二进制 PLY（<目录>/<节点名>.ply），点按 Morton 顺序存储
+// 节点名为 r 加上从根起每层的卦限（0-7，x | y << 1 | z << 2），例如 r、r3、r37
+// 内部节点保存范围内点的网格抽样（每格一个点），叶节点保存全部点；显示时节点被它的子节点替换，不叠加（见 PlyLodIndex::select）
+
+// 建立 LOD 的选项
+struct PlyLodOptions {
+    PlyBounds bounds;              // 点云包围盒，PlyLodWriter 必须提供；范围外的点归入边上的格子
+    size_t maxNodePoints = 65536;  // 点数不超过它的节点成为叶节点；内部节点的抽样格数不超过它
+    int maxDepth = 16;             // 最深的层级（根为 0），这一层的节点不再细分
+    // 追加时先按这一层的格子把点分到临时文件（最多 8^partitionLevels 个），之后逐格在内存中建立子树，
+    // 每格的点需要能放进内存；点云很大或分布很集中时调大
+    int partitionLevels = 3;
+    bool littleEndian = isLittleEndian();  // 节点文件的字节序
+    size_t threads = 0;                    // 0 表示全部硬件线程
+    PlyIOStats* stats = nullptr;           // 非空时累加读写统计
+};
+
+// LOD 的节点列表，保存为 <目录>/lod.txt
+class PlyLodIndex {
+public:
+    struct Node {
+        std::string name;
+        uint64_t count = 0;
+    };
+
+    static std::string indexPath(const std::string& directory) { return directory + "/lod.txt"; }
+    static std::string nodePath(const std::string& directory, const std::string& name) { return directory + "/" + name + ".ply"; }
+    static int level(const std::string& name) { return static_cast<int>(name.size()) - 1; }
+
+    PlyLodIndex() = default;
+    PlyLodIndex(const PlyBounds& cube, std::vector<Node> nodes) : cube_(cube), nodes_(std::move(nodes)) {
+        std::sort(nodes_.begin(), nodes_.end(), [](const Node& a, const Node& b) {
+            return a.name.size() != b.name.size() ? a.name.size() < b.name.size() : a.name < b.name;
+        });
+    }
+
+    static PlyLodIndex load(const std::string& directory) {
+        const std::string path = indexPath(directory);
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file for reading: " + path);
+        }
+        std::string magic, cube, nodes;
+        int version = 0;
+        size_t count = 0;
+        PlyBounds bounds;
+        file >> magic >> version >> cube >> bounds.min[0] >> bounds.min[1] >> bounds.min[2] >> bounds.max[0] >> bounds.max[1] >>
+            bounds.max[2] >> nodes >> count;
+        if (!file || magic != "ply_lod" || version != 1 || cube != "cube" || nodes != "nodes") {
+            throw std::runtime_error("Invalid LOD index: " + path);
+        }
+        std::vector<Node> list(count);
+        for (auto& node : list) file >> node.name >> node.count;
+        if (!file) {
+            throw std::runtime_error("LOD index is truncated: " + path);
+        }
+        return PlyLodIndex(bounds, std::move(list));
+    }
+
+    void save(const std::string& directory) const {
+        const std::string path = indexPath(directory);
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file for writing: " + path);
+        }
+        // %.9g 足以让 float 原样读回
+        char line[160];
+        std::snprintf(line, sizeof(line), "ply_lod 1\ncube %.9g %.9g %.9g %.9g %.9g %.9g\nnodes %zu\n", cube_.min[0], cube_.min[1],
+                      cube_.min[2], cube_.max[0], cube_.max[1], cube_.max[2], nodes_.size());
+        file << line;
+        for (const auto& node : nodes_) file << node.name << ' ' << node.count << '\n';
+        if (!file) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    }
+
+    // 根节点的立方体
+    const PlyBounds& cube() const { return cube_; }
+    // 按层级从粗到细、同层按名称排序
+    const std::vector<Node>& nodes() const { return nodes_; }
+
+    // 节点覆盖的立方体
+    PlyBounds bounds(const std::string& name) const {
+        double min[3] = {cube_.min[0], cube_.min[1], cube_.min[2]};
+        double size = static_cast<double>(cube_.max[0]) - cube_.min[0];
+        for (size_t i = 1; i < name.size(); i++) {
+            size *= 0.5;
+            const int octant = name[i] - '0';
+            for (int axis = 0; axis < 3; axis++) {
+                if (octant >> axis & 1) min[axis] += size;
+            }
+        }
+        PlyBounds bounds;
+        for (int axis = 0; axis < 3; axis++) {
+            bounds.min[axis] = static_cast<float>(min[axis]);
+            bounds.max[axis] = static_cast<float>(min[axis] + size);
+        }
+        return bounds;
+    }
+
+    // 显示 box 范围、最细到 maxLevel 层时要载入的节点，按层级从粗到细
+    // 节点被与 box 相交的子节点替换：只返回层级为 maxLevel、或没有与 box 相交的子节点的节点，结果互不重叠
+    std::vector<const Node*> select(const PlyBounds& box, int maxLevel) const {
+        std::vector<const Node*> result;
+        for (const auto& node : nodes_) {
+            if (level(node.name) > maxLevel || !bounds(node.name).intersects(box)) continue;
+            bool refined = false;
+            for (char octant = '0'; octant < '8' && !refined && level(node.name) < maxLevel; octant++) {
+                const std::string child = node.name + octant;
+                refined = find(child) && bounds(child).intersects(box);
+            }
+            if (!refined) result.push_back(&node);
+        }
+        return result;
+    }
+
+    // 名为 name 的节点，不存在时返回 nullptr
+    const Node* find(const std::string& name) const {
+        auto it = std::lower_bound(nodes_.begin(), nodes_.end(), name, [](const Node& node, const std::string& key) {
+            return node.name.size() != key.size() ? node.name.size() < key.size() : node.name < key;
+        });
+        return it != nodes_.end() && it->name == name ? &*it : nullptr;
+    }
+
+private:
+    PlyBounds cube_;
+    std::vector<Node> nodes_;
+};
+
+// 流式建立 LOD：append 只把点按 partitionLevels 层的格子分到目录中的临时文件，内存占用与点数无关；
+// close 时各格并行地在内存中按 Morton 码排序、递归建立子树并写出节点，再自下而上由子节点文件抽样出上面几层
+// 点的格子由 63 位 Morton 码（每轴 21 位）给出，同一节点的点在排序后连续，子节点按卦限切分即可
+template<typename VertexType>
+class PlyLodWriter {
+public:
+    static constexpr int kKeyLevels = 21;
+    static constexpr size_t kBucketBytes = 1 << 18;  // 每个临时文件的写缓冲
+
+    PlyLodWriter(const std::string& directory, const PlyLodOptions& options = PlyLodOptions())
+        : directory_(directory), options_(options), plan_(positionPlan(vertexLayout<VertexType>(), sizeof(VertexType))) {
+        if (options_.bounds.empty()) {
+            throw std::invalid_argument("PlyLodOptions::bounds must be set: " + directory_);
+        }
+        if (options_.maxNodePoints < 8) {
+            throw std::invalid_argument("PlyLodOptions::maxNodePoints must be at least 8: " + directory_);
+        }
+        if (::mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Failed to create directory: " + directory_);
+        }
+        // 内部节点按低 sampleLevels_ 层的格子抽样，格数 8^sampleLevels_ 不超过 maxNodePoints
+        while (sampleLevels_ < 7 && (size_t(1) << (3 * (sampleLevels_ + 1))) <= options_.maxNodePoints) sampleLevels_++;
+        maxDepth_ = std::max(0, std::min(options_.maxDepth, kKeyLevels - sampleLevels_));
+        partitionLevels_ = std::max(0, std::min(options_.partitionLevels, maxDepth_));
+        buckets_.resize(size_t(1) << (3 * partitionLevels_));
+
+        // 外接立方体，中心与包围盒相同
+        const PlyBounds& bounds = options_.bounds;
+        double size = 0;
+        for (int axis = 0; axis < 3; axis++) size = std::max(size, static_cast<double>(bounds.max[axis]) - bounds.min[axis]);
+        if (size <= 0) size = 1;
+        for (int axis = 0; axis < 3; axis++) {
+            const double center = (static_cast<double>(bounds.min[axis]) + bounds.max[axis]) * 0.5;
+            cube_.min[axis] = static_cast<float>(center - size * 0.5);
+            cube_.max[axis] = static_cast<float>(cube_.min[axis] + size);
+            origin_[axis] = cube_.min[axis];
+        }
+        scale_ = static_cast<double>(uint64_t(1) << kKeyLevels) / (static_cast<double>(cube_.max[0]) - cube_.min[0]);
+    }
+
+    ~PlyLodWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+    PlyLodWriter(const PlyLodWriter&) = delete;
+    PlyLodWriter& operator=(const PlyLodWriter&) = delete;
+
+    // 追加一批点；坐标不是有限值的点跳过
+    void append(const VertexType* vertices, size_t count) {
+        if (closed_) {
+            throw std::logic_error("PlyLodWriter is closed");
+        }
+        const size_t batch = PlyReader::kBlockVertices * 4;
+        std::vector<uint64_t> keys(std::min(count, batch));
+        for (size_t first = 0; first < count; first += batch) {
+            const size_t n = std::min(batch, count - first);
+            computeKeys(vertices + first, n, keys.data(), options_.threads);
+            const int shift = 3 * (kKeyLevels - partitionLevels_);
+            for (size_t i = 0; i < n; i++) {
+                if (keys[i] == kSkipped) {
+                    skipped_++;
+                    continue;
+                }
+                Bucket& bucket = buckets_[keys[i] >> shift];
+                const char* vertex = reinterpret_cast<const char*>(vertices + first + i);
+                bucket.buffer.insert(bucket.buffer.end(), vertex, vertex + sizeof(VertexType));
+                bucket.count++;
+                if (bucket.buffer.size() >= kBucketBytes) flush(keys[i] >> shift);
+            }
+            count_ += n;
+        }
+    }
+
+    void append(const std::vector<VertexType>& vertices) { append(vertices.data(), vertices.size()); }
+
+    // 建立并写出全部节点和 lod.txt，返回节点列表；之后不能再追加
+    const PlyLodIndex& close() {
+        if (closed_) return index_;
+        closed_ = true;
+        std::vector<size_t> occupied;
+        for (size_t b = 0; b < buckets_.size(); b++) {
+            if (buckets_[b].count == 0) continue;
+            flush(b);
+            occupied.push_back(b);
+        }
+
+        // 各格的子树互不相关，动态分给各线程；线程内部不再并行
+        std::vector<std::vector<PlyLodIndex::Node>> subtrees(occupied.size());
+        parallelForDynamic(occupied.size(), [&](size_t i, size_t) {
+            buildBucket(occupied[i], subtrees[i]);
+        }, options_.threads);
+        std::vector<PlyLodIndex::Node> nodes;
+        std::vector<Merged> level;
+        for (const auto& subtree : subtrees) {
+            nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+            level.push_back(Merged{subtree.front(), subtree.size() == 1});
+        }
+
+        // 自下而上：上一层的每个节点由它已写出的子节点文件合并、抽样得到；
+        // 子节点都是叶节点且合起来不超过 maxNodePoints 时合并为一个叶节点，删去子节点
+        std::set<std::string> removed;
+        for (int depth = partitionLevels_ - 1; depth >= 0; depth--) {
+            std::vector<std::vector<Merged>> children;
+            std::vector<std::string> parents;
+            for (const auto& child : level) {
+                const std::string parent = child.node.name.substr(0, child.node.name.size() - 1);
+                if (parents.empty() || parents.back() != parent) {
+                    parents.push_back(parent);
+                    children.emplace_back();
+                }
+                children.back().push_back(child);
+            }
+            level.assign(parents.size(), Merged());
+            parallelForDynamic(parents.size(), [&](size_t i, size_t) {
+                level[i] = mergeChildren(parents[i], depth, children[i]);
+            }, options_.threads);
+            for (size_t i = 0; i < parents.size(); i++) {
+                nodes.push_back(level[i].node);
+                if (!level[i].leaf) continue;
+                for (const auto& child : children[i]) removed.insert(child.node.name);
+            }
+        }
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](const PlyLodIndex::Node& node) { return removed.count(node.name) > 0; }),
+                    nodes.end());
+
+        index_ = PlyLodIndex(cube_, std::move(nodes));
+        index_.save(directory_);
+        return index_;
+    }
+
+    // 已追加的点数（含跳过的）和其中坐标不是有限值而跳过的点数
+    size_t count() const { return count_; }
+    size_t skipped() const { return skipped_; }
+
+private:
+    static constexpr uint64_t kSkipped = ~uint64_t(0);
+
+    struct Bucket {
+        std::vector<char> buffer;
+        size_t count = 0;      // 已追加到这一格的点数（含尚在缓冲中的）
+        bool created = false;  // 临时文件已由本次建立（截断过）
+    };
+
+    // 自下而上合并时的一个节点
+    struct Merged {
+        PlyLodIndex::Node node;
+        bool leaf = false;
+    };
+
+    std::string bucketPath(size_t bucket) const { return directory_ + "/.partition" + std::to_string(bucket) + ".tmp"; }
+
+    // 各点在根立方体中的 Morton 码，坐标不是有限值时为 kSkipped
+    void computeKeys(const VertexType* vertices, size_t count, uint64_t* keys, size_t threads) const {
+        constexpr size_t kTile = 4096;
+        const uint32_t last = (1u << kKeyLevels) - 1;
+        parallelFor((count + kTile - 1) / kTile, [&](size_t begin, size_t end, size_t) {
+            std::vector<PlyPosition> positions(kTile);
+            for (size_t tile = begin; tile < end; tile++) {
+                const size_t first = tile * kTile;
+                const size_t n = std::min(kTile, count - first);
+                plan_.apply(reinterpret_cast<const char*>(vertices + first), n, reinterpret_cast<char*>(positions.data()));
+                for (size_t i = 0; i < n; i++) {
+                    const float coordinates[3] = {positions[i].x, positions[i].y, positions[i].z};
+                    uint32_t cells[3];
+                    bool finite = true;
+                    for (int axis = 0; axis < 3; axis++) {
+                        finite = finite && std::isfinite(coordinates[axis]);
+                        const double cell = (coordinates[axis] - origin_[axis]) * scale_;
+                        cells[axis] = finite ? static_cast<uint32_t>(std::min<double>(last, std::max(0.0, cell))) : 0;
+                    }
+                    keys[first + i] = finite ? mortonEncode(cells[0], cells[1], cells[2]) : kSkipped;
+                }
+            }
+        }, threads);
+    }
+
+    // 把一格的缓冲追加到它的临时文件；每次打开再关闭，格数再多也不会占满文件描述符
+    // 第一次写时截断，目录里中断的上次运行留下的同名临时文件不会混进来
+    void flush(size_t index) {
+        Bucket& bucket = buckets_[index];
+        if (bucket.buffer.empty()) return;
+        const std::string path = bucketPath(index);
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (bucket.created ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file for writing: " + path);
+        }
+        bucket.created = true;
+        size_t done = 0, calls = 0;
+        {
+            PlyStatsScope scope(options_.stats, PlyIOStats::kIO);
+            while (done < bucket.buffer.size()) {
+                const ssize_t wrote = ::write(fd, bucket.buffer.data() + done, bucket.buffer.size() - done);
+                calls++;
+                if (wrote < 0) {
+                    if (errno == EINTR) continue;
+                    ::close(fd);
+                    throw std::runtime_error("Failed to write file: " + path);
+                }
+                done += static_cast<size_t>(wrote);
+            }
+        }
+        if (options_.stats) {
+            options_.stats->addWrite(done, calls);
+            options_.stats->addCalls(2);
+        }
+        ::close(fd);
+        bucket.buffer.clear();
+    }
+
+    // 读入一格的临时文件（读完即删除），按 Morton 码排序后递归写出这一格的子树，节点追加到 nodes（第一个为子树的根）
+    void buildBucket(size_t index, std::vector<PlyLodIndex::Node>& nodes) const {
+        const size_t count = buckets_[index].count;
+        const std::string path = bucketPath(index);
+        PlyUninitializedVector<VertexType> points(count);
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file for reading: " + path);
+        }
+        try {
+            readFileBytes(fd, path, options_.stats, reinterpret_cast<char*>(points.data()), count * sizeof(VertexType), 0);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        ::unlink(path.c_str());
+
+        PlyUninitializedVector<VertexType> sorted;
+        std::vector<uint64_t> keys;
+        sortByKey(points.data(), count, sorted, keys);
+        std::string name = "r";
+        for (int depth = partitionLevels_ - 1; depth >= 0; depth--) name += static_cast<char>('0' + ((index >> (3 * depth)) & 7));
+        buildNode(name, partitionLevels_, sorted.data(), keys.data(), count, nodes);
+    }
+
+    // 按 Morton 码稳定排序，结果放到 sorted 和 keys
+    void sortByKey(const VertexType* points, size_t count, PlyUninitializedVector<VertexType>& sorted, std::vector<uint64_t>& keys) const {
+        keys.resize(count);
+        computeKeys(points, count, keys.data(), 1);
+        PlyUninitializedVector<PlySortEntry> entries(count);
+        for (size_t i = 0; i < count; i++) entries[i] = PlySortEntry{keys[i], i};
+        radixSort(entries, 3 * kKeyLevels, 1);
+        sorted.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            sorted[i] = points[entries[i].index];
+            keys[i] = entries[i].key;
+        }
+    }
+
+    // 节点 name（层级 depth）包含已排序的 count 个点：点少或到达最深层时全部写出，
+    // 否则写出抽样，再按下一层的卦限切成连续的几段递归
+    void buildNode(const std::string& name, int depth, const VertexType* points, const uint64_t* keys, size_t count,
+                   std::vector<PlyLodIndex::Node>& nodes) const {
+        if (count <= options_.maxNodePoints || depth == maxDepth_) {
+            nodes.push_back(writeNode(name, points, count));
+            return;
+        }
+        nodes.push_back(writeSample(name, depth, points, keys, count));
+        const int shift = 3 * (kKeyLevels - depth - 1);
+        for (size_t begin = 0; begin < count;) {
+            const uint64_t cell = keys[begin] >> shift;
+            size_t end = begin + 1;
+            while (end < count && keys[end] >> shift == cell) end++;
+            buildNode(name + static_cast<char>('0' + (cell & 7)), depth + 1, points + begin, keys + begin, end - begin, nodes);
+            begin = end;
+        }
+    }
+
+    // 每个抽样格取排序后的第一个点
+    PlyLodIndex::Node writeSample(const std::string& name, int depth, const VertexType* points, const uint64_t* keys, size_t count) const {
+        const int shift = 3 * (kKeyLevels - depth - sampleLevels_);
+        std::vector<VertexType> sample;
+        for (size_t i = 0; i < count; i++) {
+            if (i == 0 || keys[i] >> shift != keys[i - 1] >> shift) sample.push_back(points[i]);
+        }
+        return writeNode(name, sample.data(), sample.size());
+    }
+
+    // 上层节点：合并子节点文件中的点，点少时全部保留，否则抽样；子节点都是叶节点且全部保留时删除子节点文件
+    Merged mergeChildren(const std::string& name, int depth, const std::vector<Merged>& children) const {
+        std::vector<VertexType> points;
+        bool leaves = true;
+        for (const auto& child : children) {
+            std::vector<VertexType> part;
+            PlyReader(PlyLodIndex::nodePath(directory_, child.node.name), options_.stats).read(part, 1);
+            points.insert(points.end(), part.begin(), part.end());
+            leaves = leaves && child.leaf;
+        }
+        PlyUninitializedVector<VertexType> sorted;
+        std::vector<uint64_t> keys;
+        sortByKey(points.data(), points.size(), sorted, keys);
+        if (points.size() > options_.maxNodePoints) return Merged{writeSample(name, depth, sorted.data(), keys.data(), sorted.size()), false};
+        const Merged merged{writeNode(name, sorted.data(), sorted.size()), leaves};
+        if (leaves) {
+            for (const auto& child : children) ::unlink(PlyLodIndex::nodePath(directory_, child.node.name).c_str());
+        }
+        return merged;
+    }
+
+    PlyLodIndex::Node writeNode(const std::string& name, const VertexType* points, size_t count) const {
+        PlyWriteOptions options;
+        options.littleEndian = options_.littleEndian;
+        options.threads = 1;
+        options.stats = options_.stats;
+        options.boundsInHeader = true;
+        PlyBinaryIO(PlyLodIndex::nodePath(directory_, name)).write(std::vector<VertexType>(points, points + count), options);
+        return PlyLodIndex::Node{name, count};
+    }
+
+    std::string directory_;
+    PlyLodOptions options_;
+    ConversionPlan plan_;
+    int sampleLevels_ = 1;
+    int maxDepth_ = 0;
+    int partitionLevels_ = 0;
+    PlyBounds cube_;
+    double origin_[3] = {0, 0, 0};
+    double scale_ = 1;
+    std::vector<Bucket> buckets_;
+    size_t count_ = 0;
+    size_t skipped_ = 0;
+    bool closed_ = false;
+    PlyLodIndex index_;
+};
+
+// 从已有的二进制 PLY 分批读取并建立 LOD，内存占用与文件大小无关
+// options.bounds 为空时优先用头部的 obj_info bbox，没有时先按位置扫描一遍
+template<typename VertexType>
+PlyLodIndex buildPlyLod(const std::string& input, const std::string& directory, PlyLodOptions options = PlyLodOptions()) {
+    const PlyReader reader(input, options.stats);
+    if (options.bounds.empty()) {
+        if (reader.header().hasBounds) {
+            options.bounds = reader.header().bounds;
+        } else {
+            reader.readBatches<PlyPosition>(PlyReader::kBlockVertices, [&](PlyVertexView<PlyPosition> view) {
+                for (const auto& position : view) {
+                    if (std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z)) options.bounds.expand(position);
+                }
+            });
+        }
+    }
+    PlyLodWriter<VertexType> writer(directory, options);
+    reader.readBatches<VertexType>(PlyReader::kBlockVertices * 4, [&](PlyVertexView<VertexType> view) {
+        writer.append(view.data(), view.size());
+    });
+    return writer.close();
+}
+
+// asc 文件中无法解析的行
+struct AscParseError {
+    size_t line;  // 从 1 开始的行号
+    std::string text;
+};
+
+// 分隔符：空格、制表符、逗号（以及 Windows 换行的 \r）
+inline bool isAscDelimiter(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+// 解析一行 XYZRGB，不分配内存；颜色为 0~1 的浮点数
+inline bool parseAscLine(const char* begin, const char* end, CustomVertex& point) {
+    float values[6];
+    const char* p = begin;
+    for (float& value : values) {
+        while (p < end && isAscDelimiter(*p)) p++;
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc() || (result.ptr < end && !isAscDelimiter(*result.ptr))) {
+            return false;
+        }
+        p = result.ptr;
+    }
+    point.x = values[0];
+    point.y = values[1];
+    point.z = values[2];
+    point.r = convertValue<unsigned char>(values[3] * 255);
+    point.g = convertValue<unsigned char>(values[4] * 255);
+    point.b = convertValue<unsigned char>(values[5] * 255);
+    return true;
+}
+
+// 读取asc文件，结果追加到 points 末尾
+// 文件按换行对齐切块后多线程解析：先并行数行数得到每块的输出位置，再并行解析直接写入
+// 无法解析的行记录到 errors（若提供），空行忽略
+inline bool readAscFile(const std::string& filename, std::vector<CustomVertex>& points,
+                        std::vector<AscParseError>* errors = nullptr) {
+    std::unique_ptr<MappedFile> mapping;
+    try {
+        mapping = std::make_unique<MappedFile>(filename);
+    } catch (const std::exception&) {
+        std::cerr << "无法打开文件: " << filename << std::endl;
+        return false;
+    }
+    const char* data = mapping->data();
+    const size_t size = mapping->size();
+    if (size == 0) return true;
+
+    // 按换行对齐切块，每块至少 1MB
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<size_t> bounds = splitLines(data, size, std::max<size_t>(1, std::min(threads * 4, size / (1 << 20))));
+    const size_t chunks = bounds.size() - 1;
+
+    // 第一遍：每块的行数
+    std::vector<size_t> lineCounts(chunks + 1, 0);
+    parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+        for (size_t c = begin; c < end; c++) {
+            lineCounts[c + 1] = countLines(data + bounds[c], data + bounds[c + 1]);
+        }
+    });
+    std::vector<size_t> lineStarts(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; c++) lineStarts[c + 1] = lineStarts[c] + lineCounts[c + 1];
+
+    // 第二遍：解析，每块写到自己的行号对应位置
+    const size_t base = points.size();
+    points.resize(base + lineStarts[chunks]);
+    std::vector<size_t> validCounts(chunks, 0);
+    std::vector<std::vector<AscParseError>> chunkErrors(chunks);
+    parallelFor(chunks, [&](size_t begin, size_t end, size_t) {
+        for (size_t c = begin; c < end; c++) {
+            CustomVertex* out = points.data() + base + lineStarts[c];
+            size_t line = lineStarts[c];
+            const char* p = data + bounds[c];
+            const char* last = data + bounds[c + 1];
+            while (p < last) {
+                const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', last - p));
+                if (!lineEnd) lineEnd = last;
+                line++;
+                const char* q = p;
+                while (q < lineEnd && isAscDelimiter(*q)) q++;
+                if (q < lineEnd) {
+                    if (parseAscLine(q, lineEnd, out[validCounts[c]])) {
+                        validCounts[c]++;
+                    } else if (errors) {
+                        const char* textEnd = lineEnd > p && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+                        chunkErrors[c].push_back(AscParseError{line, std::string(p, textEnd)});
+                    }
+                }
+                p = lineEnd + 1;
+            }
+        }
+    });
+
+    // 把各块的有效点前移，去掉无效行留下的空位
+    size_t total = base;
+    for (size_t c = 0; c < chunks; c++) {
+        const size_t from = base + lineStarts[c];
+        if (from != total && validCounts[c] > 0) {
+            std::memmove(points.data() + total, points.data() + from, validCounts[c] * sizeof(CustomVertex));
+        }
+        total += validCounts[c];
+        if (errors) errors->insert(errors->end(), chunkErrors[c].begin(), chunkErrors[c].end());
+    }
+    points.resize(total);
+    return true;
+}
@@ -0,0 +1,471 @@
+// 读写性能基准：生成合成点云，测量各读写方式的吞吐量
+// 用法：ply_bench [--points 1M,100M,1B] [--schemas xyz,xyzrgb,xyzn64] [--modes read,write,...]
+//                 [--dir 目录] [--threads N] [--format json|csv]
+// 每个结果输出一行（JSON 或 CSV），便于和历史结果比较；进度信息输出到 stderr
+// 注意：点云和读回的结果都在内存中，1B 点需要几十 GB 内存和磁盘；读取测的是文件在页缓存中的情况
+#include "ply2.h"
+
+#include <chrono>
+#include <cstdio>
+
+// xyz
+struct PointXYZ {
+    float x, y, z;
+    REFLECTABLE(
+        MEMBER_INFO(PointXYZ, x, float),
+        MEMBER_INFO(PointXYZ, y, float),
+        MEMBER_INFO(PointXYZ, z, float)
+    )
+};
+
+// double 坐标加法向量，有填充（sizeof 为 40，文件记录为 36 字节）
+struct PointXYZNormal64 {
+    double x, y, z;
+    float nx, ny, nz;
+    REFLECTABLE(
+        MEMBER_INFO(PointXYZNormal64, x, double),
+        MEMBER_INFO(PointXYZNormal64, y, double),
+        MEMBER_INFO(PointXYZNormal64, z, double),
+        MEMBER_INFO(PointXYZNormal64, nx, float),
+        MEMBER_INFO(PointXYZNormal64, ny, float),
+        MEMBER_INFO(PointXYZNormal64, nz, float)
+    )
+};
+
+// 类型转换读取的目标
+struct PointDouble {
+    double x, y, z;
+    REFLECTABLE(
+        MEMBER_INFO(PointDouble, x, double),
+        MEMBER_INFO(PointDouble, y, double),
+        MEMBER_INFO(PointDouble, z, double)
+    )
+};
+
+// 确定性的伪随机数，按点的序号生成，可以并行
+uint64_t benchHash(uint64_t i) {
+    i += 0x9e3779b97f4a7c15ull;
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ull;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebull;
+    return i ^ (i >> 31);
+}
+
+// 模拟扫描线：每行 4096 个点，5mm 间距，高度有起伏和噪声
+void benchPosition(size_t i, double& x, double& y, double& z) {
+    const uint64_t h = benchHash(i);
+    x = 1000.0 + static_cast<double>(i % 4096) * 0.005;
+    y = 2000.0 + static_cast<double>(i / 4096) * 0.005;
+    z = 50.0 + std::sin(x * 0.1) * std::cos(y * 0.1) + static_cast<double>(h % 1000) * 1e-5;
+}
+
+void fillPoint(PointXYZ& p, size_t i) {
+    double x, y, z;
+    benchPosition(i, x, y, z);
+    p = PointXYZ{static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)};
+}
+
+void fillPoint(CustomVertex& p, size_t i) {
+    double x, y, z;
+    benchPosition(i, x, y, z);
+    const uint64_t h = benchHash(i);
+    p.x = static_cast<float>(x);
+    p.y = static_cast<float>(y);
+    p.z = static_cast<float>(z);
+    p.r = static_cast<unsigned char>(h >> 8);
+    p.g = static_cast<unsigned char>(h >> 16);
+    p.b = static_cast<unsigned char>(h >> 24);
+}
+
+void fillPoint(PointXYZNormal64& p, size_t i) {
+    benchPosition(i, p.x, p.y, p.z);
+    p.nx = static_cast<float>(std::cos(p.x * 0.1) * 0.1);
+    p.ny = static_cast<float>(std::sin(p.y * 0.1) * 0.1);
+    p.nz = 1.0f;
+}
+
+template<typename VertexType>
+void generateCloud(std::vector<VertexType>& points, size_t count, size_t threads) {
+    points.resize(count);
+    parallelFor(count, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; i++) fillPoint(points[i], i);
+    }, threads);
+}
+
+struct BenchOptions {
+    std::vector<size_t> points{1000000};
+    std::vector<std::string> schemas{"xyz", "xyzrgb", "xyzn64"};
+    std::vector<std::string> modes;  // 为空表示全部
+    std::string dir = ".";
+    size_t threads = 0;
+    bool csv = false;
+};
+
+struct BenchResult {
+    std::string schema;
+    size_t points;
+    std::string endian;
+    std::string mode;
+    double seconds;
+    size_t bytes;  // 读写的文件字节数
+};
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchOptions& options) : options_(options) {
+        if (options_.csv) std::cout << "schema,points,endian,mode,seconds,bytes,gb_per_s,points_per_s\n";
+    }
+
+    template<typename VertexType>
+    void run(const std::string& schema, size_t count) {
+        std::vector<VertexType> points;
+        std::cerr << "generating " << schema << " x " << count << std::endl;
+        generateCloud(points, count, options_.threads);
+
+        for (bool littleEndian : {true, false}) {
+            const std::string endian = littleEndian ? "little" : "big";
+            const std::string file = options_.dir + "/ply_bench_" + schema + "_" + endian + ".ply";
+            PlyWriteOptions writeOptions;
+            writeOptions.littleEndian = littleEndian;
+            writeOptions.threads = options_.threads;
+
+            measure(schema, count, endian, "write", file, [&] { PlyBinaryIO(file).write(points, writeOptions); });
+            // 写入时顺带统计包围盒并回填到头部
+            measure(schema, count, endian, "write_stats", file, [&] {
+                PlyCloudStats cloudStats;
+                PlyWriteOptions statsOptions = writeOptions;
+                statsOptions.cloudStats = &cloudStats;
+                statsOptions.boundsInHeader = true;
+                PlyBinaryIO(file).write(points, statsOptions);
+            });
+            if (!fileExists(file)) PlyBinaryIO(file).write(points, writeOptions);
+            runReads<VertexType>(schema, count, endian, file);
+
+            if (enabled("write_columns") || enabled("read_columns")) {
+                PlyColumns columns;
+                measure(schema, count, endian, "read_columns", file, [&] { columns = PlyReader(file).readColumns<VertexType>(); });
+                if (columns.rows() == 0) columns = PlyReader(file).readColumns<VertexType>();
+                const std::string out = file + ".columns.ply";
+                measure(schema, count, endian, "write_columns", out, [&] { PlyBinaryIO(out).writeColumns(columns, writeOptions); });
+                ::unlink(out.c_str());
+            }
+
+            // 沿空间填充曲线重新排序后写出，计时包含排序
+            const std::string ordered = file + ".ordered.ply";
+            for (auto curve : {PlySpatialOrder::kMorton, PlySpatialOrder::kHilbert}) {
+                PlyWriteOptions orderedOptions = writeOptions;
+                orderedOptions.order = curve;
+                const std::string mode = curve == PlySpatialOrder::kMorton ? "write_morton" : "write_hilbert";
+                measure(schema, count, endian, mode, ordered, [&] { PlyBinaryIO(ordered).write(points, orderedOptions); });
+            }
+            ::unlink(ordered.c_str());
+
+            const std::string appended = file + ".append.ply";
+            measure(schema, count, endian, "write_append", appended, [&] {
+                PlyAppendWriter<VertexType> writer(appended, writeOptions);
+                for (size_t first = 0; first < count; first += PlyReader::kBlockVertices) {
+                    writer.append(points.data() + first, std::min(PlyReader::kBlockVertices, count - first));
+                }
+                writer.close();
+            });
+            ::unlink(appended.c_str());
+
+            // ASCII 和量化压缩与字节序无关，只测一次
+            if (littleEndian) runEncodings(schema, count, file, points);
+            ::unlink(file.c_str());
+            ::unlink(PlyChunkIndex::sidecarPath(file).c_str());
+        }
+    }
+
+private:
+    template<typename VertexType>
+    void runReads(const std::string& schema, size_t count, const std::string& endian, const std::string& file) {
+        // 每次读入新的 vector，计时包含分配内存，各方式之间可比
+        measure(schema, count, endian, "read", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyReader(file).read(vertices, options_.threads);
+        });
+        measure(schema, count, endian, "read_uninitialized", file, [&] {
+            PlyUninitializedVector<VertexType> vertices;
+            PlyReader(file).read(vertices, options_.threads);
+        });
+        measure(schema, count, endian, "read_single_thread", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyReader(file).read(vertices, 1);
+        });
+        measure(schema, count, endian, "read_convert", file, [&] {
+            std::vector<PointDouble> converted;
+            PlyReader(file).read(converted, options_.threads);
+        });
+
+        // 视图和分批读取在计时内遍历所有顶点，保证数据真正被读入
+        measure(schema, count, endian, "read_mapped", file, [&] {
+            auto view = PlyBinaryIO(file).readMapped<VertexType>();
+            consume(view.begin(), view.end());
+        });
+        measure(schema, count, endian, "read_batches", file, [&] {
+            PlyReader(file).readBatches<VertexType>(1 << 20, [&](PlyVertexView<VertexType> view) {
+                consume(view.begin(), view.end());
+            });
+        });
+        measure(schema, count, endian, "read_projection", file, [&] { PlyReader(file).readColumns({"x"}); });
+
+        measure(schema, count, endian, "read_positions", file, [&] {
+            std::vector<PlyPosition> positions;
+            PlyReader(file).read(positions, options_.threads);
+        });
+
+        measure(schema, count, endian, "read_stats", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyCloudStats cloudStats;
+            PlyReader(file).read(vertices, cloudStats, options_.threads);
+        });
+
+        // 读取时降采样；体素为 5cm，约为扫描点距的 10 倍
+        measure(schema, count, endian, "read_decimated_stride", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyReader(file).readDecimated(PlyDecimation::everyNth(10), vertices, options_.threads);
+        });
+        measure(schema, count, endian, "read_decimated_random", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyReader(file).readDecimated(PlyDecimation::random(0.1), vertices, options_.threads);
+        });
+        measure(schema, count, endian, "read_decimated_voxel", file, [&] {
+            std::vector<VertexType> vertices;
+            PlyReader(file).readDecimated(PlyDecimation::voxelGrid(0.05), vertices, options_.threads);
+        });
+    }
+
+    template<typename VertexType>
+    void runEncodings(const std::string& schema, size_t count, const std::string& file, const std::vector<VertexType>& points) {
+        PlyWriteOptions writeOptions;
+        writeOptions.threads = options_.threads;
+
+        const std::string ascii = file + ".ascii.ply";
+        writeOptions.ascii = true;
+        measure(schema, count, "ascii", "write_ascii", ascii, [&] { PlyBinaryIO(ascii).write(points, writeOptions); });
+        if (enabled("read_ascii") && !fileExists(ascii)) PlyBinaryIO(ascii).write(points, writeOptions);
+        measure(schema, count, "ascii", "read_ascii", ascii, [&] {
+            std::vector<VertexType> vertices;
+            PlyBinaryIO(ascii).read(vertices);
+        });
+        ::unlink(ascii.c_str());
+
+        const std::string quantized = file + ".quantized.ply";
+        writeOptions.ascii = false;
+        writeOptions.quantization = 0.001;
+        measure(schema, count, "quantized", "write_quantized", quantized, [&] { PlyBinaryIO(quantized).write(points, writeOptions); });
+        if (enabled("read_quantized") && !fileExists(quantized)) PlyBinaryIO(quantized).write(points, writeOptions);
+        measure(schema, count, "quantized", "read_quantized", quantized, [&] {
+            std::vector<VertexType> vertices;
+            PlyBinaryIO(quantized).read(vertices);
+        });
+        ::unlink(quantized.c_str());
+
+        // 切成每块 4096 个点的小文件，批量读回，再不解码地合并成一个文件
+        if (enabled("read_tiles") || enabled("merge_tiles")) {
+            const size_t tile = 4096;
+            std::vector<std::string> tiles;
+            size_t bytes = 0;
+            writeOptions.quantization = 0;
+            for (size_t first = 0; first < count; first += tile) {
+                tiles.push_back(file + ".tile" + std::to_string(tiles.size()) + ".ply");
+                std::vector<VertexType> part(points.begin() + first, points.begin() + std::min(count, first + tile));
+                PlyBinaryIO(tiles.back()).write(part, writeOptions);
+                bytes += fileSize(tiles.back());
+            }
+            measure(schema, count, "little", "read_tiles", file, [&] {
+                PlyUninitializedVector<VertexType> vertices;
+                std::vector<uint64_t> offsets;
+                PlyBatchReader<VertexType>().read(tiles, vertices, offsets, options_.threads);
+                return bytes;
+            });
+            const std::string merged = file + ".merged.ply";
+            measure(schema, count, "little", "merge_tiles", merged, [&] { mergePly(tiles, merged, options_.threads); });
+            ::unlink(merged.c_str());
+            for (const auto& path : tiles) ::unlink(path.c_str());
+        }
+
+        // 不解码地拆成 16 个文件，以及裁出中间一半；字节数为写出的文件
+        if (enabled("split") || enabled("crop")) {
+            std::vector<std::string> parts;
+            for (size_t i = 0; i < 16; i++) parts.push_back(file + ".part" + std::to_string(i) + ".ply");
+            measure(schema, count, "little", "split", file, [&] {
+                splitPly(file, parts, options_.threads);
+                size_t bytes = 0;
+                for (const auto& path : parts) bytes += fileSize(path);
+                return bytes;
+            });
+            for (const auto& path : parts) ::unlink(path.c_str());
+            const std::string cropped = file + ".crop.ply";
+            measure(schema, count, "little", "crop", cropped, [&] { cropPly(file, cropped, count / 4, count / 2); });
+            ::unlink(cropped.c_str());
+        }
+
+        // 空间索引：建立一次，然后查询约 1% 的点
+        PlyChunkIndex index;
+        measure(schema, count, "little", "index_build", file, [&] { index = PlyChunkIndex::build(PlyReader(file)); });
+        if (enabled("index_query")) {
+            if (index.chunks() == 0) index = PlyChunkIndex::build(PlyReader(file));
+            PlyBounds box = index.bounds();
+            box.max[1] = box.min[1] + (box.max[1] - box.min[1]) * 0.01f;
+            // 字节数为实际读取的块
+            measure(schema, count, "little", "index_query", file, [&] {
+                const PlyReader reader(file);
+                std::vector<VertexType> hits;
+                index.query(reader, box, hits);
+                size_t vertices = 0;
+                for (const auto& range : index.ranges(box)) vertices += range.second;
+                return vertices * reader.header().vertexSize();
+            });
+        }
+
+        // 多分辨率八叉树：流式读入、分格、建树，字节数为写出的全部节点文件
+        const std::string lod = file + ".lod";
+        PlyLodOptions lodOptions;
+        lodOptions.threads = options_.threads;
+        PlyLodIndex lodIndex;
+        measure(schema, count, "little", "build_lod", lod, [&] {
+            lodIndex = buildPlyLod<VertexType>(file, lod, lodOptions);
+            size_t bytes = fileSize(PlyLodIndex::indexPath(lod));
+            for (const auto& node : lodIndex.nodes()) bytes += fileSize(PlyLodIndex::nodePath(lod, node.name));
+            return bytes;
+        });
+        for (const auto& node : lodIndex.nodes()) ::unlink(PlyLodIndex::nodePath(lod, node.name).c_str());
+        ::unlink(PlyLodIndex::indexPath(lod).c_str());
+        ::rmdir(lod.c_str());
+    }
+
+    template<typename Iterator>
+    void consume(Iterator begin, Iterator end) {
+        double sum = 0;
+        for (auto it = begin; it != end; ++it) sum += it->x;
+        checksum_ += sum;
+    }
+
+    static bool fileExists(const std::string& file) {
+        struct stat st;
+        return ::stat(file.c_str(), &st) == 0;
+    }
+
+    static size_t fileSize(const std::string& file) {
+        struct stat st;
+        return ::stat(file.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    bool enabled(const std::string& mode) const {
+        return options_.modes.empty() || std::find(options_.modes.begin(), options_.modes.end(), mode) != options_.modes.end();
+    }
+
+    // 计时执行 func；func 返回 size_t 时作为字节数，否则取执行后 file 的大小
+    template<typename Func>
+    void measure(const std::string& schema, size_t count, const std::string& endian, const std::string& mode,
+                 const std::string& file, Func&& func) {
+        if (!enabled(mode)) return;
+        std::cerr << "  " << schema << " " << endian << " " << mode << std::endl;
+        const auto start = std::chrono::steady_clock::now();
+        size_t bytes = 0;
+        if constexpr (std::is_same_v<decltype(func()), size_t>) {
+            bytes = func();
+        } else {
+            func();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report(BenchResult{schema, count, endian, mode, seconds, bytes > 0 ? bytes : fileSize(file)});
+    }
+
+    void report(const BenchResult& result) const {
+        const double seconds = std::max(result.seconds, 1e-9);
+        const double gbps = result.bytes / seconds / 1e9;
+        const double pointsPerSecond = result.points / seconds;
+        char line[512];
+        if (options_.csv) {
+            std::snprintf(line, sizeof(line), "%s,%zu,%s,%s,%.6f,%zu,%.4f,%.0f\n", result.schema.c_str(), result.points,
+                          result.endian.c_str(), result.mode.c_str(), result.seconds, result.bytes, gbps, pointsPerSecond);
+        } else {
+            std::snprintf(line, sizeof(line),
+                          "{\"schema\":\"%s\",\"points\":%zu,\"endian\":\"%s\",\"mode\":\"%s\",\"seconds\":%.6f,"
+                          "\"bytes\":%zu,\"gb_per_s\":%.4f,\"points_per_s\":%.0f}\n",
+                          result.schema.c_str(), result.points, result.endian.c_str(), result.mode.c_str(), result.seconds,
+                          result.bytes, gbps, pointsPerSecond);
+        }
+        std::cout << line << std::flush;
+    }
+
+    BenchOptions options_;
+    double checksum_ = 0;
+};
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// 1000、1K、100M、1B（十进制倍数）
+size_t parseCount(const std::string& text) {
+    size_t value = 0;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc()) {
+        throw std::invalid_argument("Invalid point count: " + text);
+    }
+    const std::string suffix(result.ptr, text.data() + text.size());
+    if (suffix == "K" || suffix == "k") return value * 1000;
+    if (suffix == "M" || suffix == "m") return value * 1000000;
+    if (suffix == "B" || suffix == "b" || suffix == "G" || suffix == "g") return value * 1000000000;
+    if (!suffix.empty()) {
+        throw std::invalid_argument("Invalid point count: " + text);
+    }
+    return value;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            const std::string value = argv[++i];
+            if (arg == "--points") {
+                options.points.clear();
+                for (const auto& item : splitList(value)) options.points.push_back(parseCount(item));
+            } else if (arg == "--schemas") {
+                options.schemas = splitList(value);
+            } else if (arg == "--modes") {
+                options.modes = splitList(value);
+            } else if (arg == "--dir") {
+                options.dir = value;
+            } else if (arg == "--threads") {
+                options.threads = parseCount(value);
+            } else if (arg == "--format") {
+                options.csv = value == "csv";
+            } else {
+                throw std::invalid_argument("Unknown option: " + arg);
+            }
+        }
+
+        BenchRunner runner(options);
+        for (size_t count : options.points) {
+            for (const auto& schema : options.schemas) {
+                if (schema == "xyz") {
+                    runner.run<PointXYZ>(schema, count);
+                } else if (schema == "xyzrgb") {
+                    runner.run<CustomVertex>(schema, count);
+                } else if (schema == "xyzn64") {
+                    runner.run<PointXYZNormal64>(schema, count);
+                } else {
+                    throw std::invalid_argument("Unknown schema: " + schema);
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
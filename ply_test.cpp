@@ -0,0 +1,1946 @@
+// 读写测试：每种读写方式写出后再读回与原始数据比较，并覆盖各自的边界情况
+// 用法：ply_test [临时目录]，默认在 /tmp 下建立并在结束时删除；有失败时返回非零
+#include "ply2.h"
+
+#include <dirent.h>
+#include <functional>
+#include <map>
+
+// 有填充的结构体（sizeof 为 32，文件记录为 30 字节）
+struct TestPadded {
+    double x, y, z;
+    float intensity;
+    unsigned short label;
+    REFLECTABLE(
+        MEMBER_INFO(TestPadded, x, double),
+        MEMBER_INFO(TestPadded, y, double),
+        MEMBER_INFO(TestPadded, z, double),
+        MEMBER_INFO(TestPadded, intensity, float),
+        MEMBER_INFO(TestPadded, label, unsigned short)
+    )
+};
+
+// 按 8 字节对齐、没有填充的结构体
+struct TestDouble {
+    double x, y, z;
+    REFLECTABLE(
+        MEMBER_INFO(TestDouble, x, double),
+        MEMBER_INFO(TestDouble, y, double),
+        MEMBER_INFO(TestDouble, z, double)
+    )
+};
+
+// 注册顺序与内存顺序不同：没有填充，但不能整体拷贝
+struct TestReordered {
+    float x, y;
+    int id;
+    REFLECTABLE(
+        MEMBER_INFO(TestReordered, id, int),
+        MEMBER_INFO(TestReordered, x, float),
+        MEMBER_INFO(TestReordered, y, float)
+    )
+};
+
+// 有未注册的成员：读写都忽略它
+struct TestPartial {
+    float x, y, z;
+    int scratch;
+    REFLECTABLE(
+        MEMBER_INFO(TestPartial, x, float),
+        MEMBER_INFO(TestPartial, y, float),
+        MEMBER_INFO(TestPartial, z, float)
+    )
+};
+
+static int failures = 0;
+
+#define PLY_CHECK(cond)                                                                      \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            failures++;                                                                      \
+        }                                                                                    \
+    } while (0)
+
+// 抛出 Exception 类型的异常才算通过
+#define PLY_CHECK_THROWS(expr, Exception)  \
+    do {                                   \
+        bool thrown = false;               \
+        try {                              \
+            expr;                          \
+        } catch (const Exception&) {       \
+            thrown = true;                 \
+        }                                  \
+        PLY_CHECK(thrown && #expr);        \
+    } while (0)
+
+static bool sameVertex(const CustomVertex& a, const CustomVertex& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+static bool sameVertex(const TestPadded& a, const TestPadded& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.intensity == b.intensity && a.label == b.label;
+}
+
+static bool sameVertex(const TestDouble& a, const TestDouble& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+template<typename A, typename B>
+static bool sameVertices(const A& a, const B& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!sameVertex(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+static uint64_t testHash(uint64_t i) {
+    i += 0x9e3779b97f4a7c15ull;
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ull;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebull;
+    return i ^ (i >> 31);
+}
+
+// 坐标为 1/64 的整数倍，量化到 1/1024 后可以精确还原
+static std::vector<CustomVertex> makeCloud(size_t count, uint64_t seed = 0) {
+    std::vector<CustomVertex> points(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i + seed * 0x100000000ull);
+        points[i].x = static_cast<float>(h % 4096) / 64.0f;
+        points[i].y = static_cast<float>(h >> 12 & 4095) / 64.0f;
+        points[i].z = static_cast<float>(h >> 24 & 1023) / 64.0f;
+        points[i].r = static_cast<unsigned char>(h >> 40);
+        points[i].g = static_cast<unsigned char>(h >> 48);
+        points[i].b = static_cast<unsigned char>(h >> 56);
+    }
+    return points;
+}
+
+static std::vector<TestDouble> makeDoubles(size_t count) {
+    std::vector<TestDouble> points(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i);
+        points[i].x = static_cast<double>(h % 100000) * 0.001;
+        points[i].y = static_cast<double>(h >> 20 & 0xffff) * 0.01;
+        points[i].z = -static_cast<double>(i);
+    }
+    return points;
+}
+
+// 按文件字节序追加一个值，用来拼出任意布局的顶点记录
+template<typename T>
+static void appendValue(std::string& bytes, T value, bool littleEndian = true) {
+    if (littleEndian != isLittleEndian()) value = swapEndian(value);
+    bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool fileExists(const std::string& file) {
+    struct stat st;
+    return ::stat(file.c_str(), &st) == 0;
+}
+
+static size_t fileSize(const std::string& file) {
+    struct stat st;
+    return ::stat(file.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+// 直接写出头部文本和原始字节，用来构造写入接口产生不了的文件
+static void writeRaw(const std::string& file, const std::string& header, const void* data = nullptr, size_t size = 0) {
+    std::ofstream out(file, std::ios::binary);
+    out << header;
+    if (size > 0) out.write(static_cast<const char*>(data), size);
+}
+
+// 写出大端的 CustomVertex 文件
+static void writeBigEndian(const std::string& file, const std::vector<CustomVertex>& points) {
+    std::string bytes;
+    for (const auto& p : points) {
+        appendValue(bytes, p.x, false);
+        appendValue(bytes, p.y, false);
+        appendValue(bytes, p.z, false);
+        bytes.append(reinterpret_cast<const char*>(&p.r), 3);
+    }
+    writeRaw(file,
+             "ply\nformat binary_big_endian 1.0\nelement vertex " + std::to_string(points.size()) +
+                 "\nproperty float x\nproperty float y\nproperty float z\nproperty uchar r\nproperty uchar g\n"
+                 "property uchar b\nend_header\n",
+             bytes.data(), bytes.size());
+}
+
+// 文件中 offset 之后的全部字节
+static std::string readTail(const std::string& file, size_t offset) {
+    std::ifstream in(file, std::ios::binary);
+    in.seekg(static_cast<std::streamoff>(offset));
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// 删除目录及其中的文件（包括一层子目录）
+static void removeTree(const std::string& dir) {
+    DIR* handle = ::opendir(dir.c_str());
+    if (!handle) return;
+    while (const dirent* entry = ::readdir(handle)) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        const std::string path = dir + "/" + name;
+        if (::unlink(path.c_str()) != 0) removeTree(path);
+    }
+    ::closedir(handle);
+    ::rmdir(dir.c_str());
+}
+
+static std::string dir;
+
+// 内存映射读取：视图比 PlyBinaryIO 活得久；CRLF 头部、未对齐的数据起点、截断和缺少 end_header
+static void testMappedRead() {
+    const std::vector<CustomVertex> points = makeCloud(100000);
+    const std::string file = dir + "/mapped.ply";
+    PlyBinaryIO(file).write(points);
+    PlyVertexView<CustomVertex> view;
+    {
+        PlyBinaryIO io(file);
+        view = io.readMapped<CustomVertex>();
+    }
+    PLY_CHECK(sameVertices(view, points));
+    PLY_CHECK(sameVertices(view.toVector(), points));
+
+    // 空文件体
+    PlyBinaryIO(file).write(std::vector<CustomVertex>());
+    PLY_CHECK(PlyBinaryIO(file).readMapped<CustomVertex>().empty());
+
+    // 头部长度决定数据起点是否按 8 字节对齐，两种情况都要读对；行尾是 CRLF 也一样
+    const std::vector<TestDouble> doubles = makeDoubles(1001);
+    const std::string doubleFile = dir + "/mapped_double.ply";
+    for (const char* comment : {"", "comment a\r\n", "comment ab\r\n", "comment abcdefg\r\n"}) {
+        writeRaw(doubleFile,
+                 std::string("ply\r\nformat binary_little_endian 1.0\r\n") + comment +
+                     "element vertex 1001\r\nproperty double x\r\nproperty double y\r\nproperty double z\r\nend_header\r\n",
+                 doubles.data(), doubles.size() * sizeof(TestDouble));
+        auto doubleView = PlyBinaryIO(doubleFile).readMapped<TestDouble>();
+        PLY_CHECK(sameVertices(doubleView, doubles));
+        PLY_CHECK(reinterpret_cast<uintptr_t>(doubleView.data()) % alignof(TestDouble) == 0);
+    }
+
+    // 少一个字节、缺少 end_header 都报错
+    PlyBinaryIO(file).write(points);
+    PLY_CHECK(::truncate(file.c_str(), fileSize(file) - 1) == 0);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).readMapped<CustomVertex>(), std::runtime_error);
+    writeRaw(file, "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty float x\n");
+    PLY_CHECK_THROWS(PlyBinaryIO(file).readMapped<CustomVertex>(), std::runtime_error);
+    PLY_CHECK_THROWS(PlyBinaryIO(dir + "/missing.ply").readMapped<CustomVertex>(), std::runtime_error);
+    ::unlink(file.c_str());
+    ::unlink(doubleFile.c_str());
+}
+
+// 转换读取：属性按名字匹配，顺序、类型和别名与结构体不同；多余的属性跳过，缺少的置零
+static void testConvertingRead() {
+    const size_t count = 5003;
+    std::vector<TestPadded> expected(count);
+    std::string bytes;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i);
+        TestPadded& p = expected[i];
+        std::memset(&p, 0, sizeof(p));
+        p.x = static_cast<float>(h % 1000) * 0.25f;
+        p.y = static_cast<double>(h >> 10 & 0xffff) * 0.001;
+        p.z = -static_cast<double>(i);
+        p.intensity = static_cast<float>(h >> 40 & 0xff) / 256.0f;
+        p.label = static_cast<unsigned short>(h >> 48 & 0xff);
+        appendValue(bytes, p.z);
+        appendValue(bytes, static_cast<float>(p.x));
+        appendValue(bytes, static_cast<int32_t>(i));
+        appendValue(bytes, p.y);
+        appendValue(bytes, static_cast<uint8_t>(p.label));
+        appendValue(bytes, static_cast<double>(p.intensity));
+    }
+    const std::string file = dir + "/convert.ply";
+    writeRaw(file,
+             "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(count) +
+                 "\nproperty double z\nproperty float32 x\nproperty int extra\nproperty float64 y\n"
+                 "property uint8 label\nproperty double intensity\nelement face 0\n"
+                 "property list uchar int vertex_indices\nend_header\n",
+             bytes.data(), bytes.size());
+    std::vector<TestPadded> read;
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, expected));
+    PLY_CHECK(sameVertices(PlyBinaryIO(file).readMapped<TestPadded>(), expected));
+
+    // 浮点转无符号字节时截断到 [0, 255]，NaN 得 0；文件里没有的 g、b 置零
+    bytes.clear();
+    const float reds[4] = {300.0f, -5.0f, std::numeric_limits<float>::quiet_NaN(), 17.9f};
+    for (float red : reds) {
+        appendValue(bytes, 1.5f);
+        appendValue(bytes, 2.5f);
+        appendValue(bytes, 3.5f);
+        appendValue(bytes, red);
+    }
+    writeRaw(file,
+             "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\n"
+             "property float z\nproperty float r\nend_header\n",
+             bytes.data(), bytes.size());
+    std::vector<CustomVertex> colors;
+    PlyBinaryIO(file).read(colors);
+    PLY_CHECK(colors.size() == 4 && colors[0].r == 255 && colors[1].r == 0 && colors[2].r == 0 && colors[3].r == 17);
+    PLY_CHECK(colors.size() == 4 && colors[3].x == 1.5f && colors[3].z == 3.5f && colors[3].g == 0 && colors[3].b == 0);
+
+    // 截断的文件和不认识的属性类型报错
+    writeRaw(file,
+             "ply\nformat binary_little_endian 1.0\nelement vertex 5\nproperty float x\nproperty float y\n"
+             "property float z\nproperty float r\nend_header\n",
+             bytes.data(), bytes.size());
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(colors), std::runtime_error);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).readMapped<CustomVertex>(), std::runtime_error);
+    writeRaw(file, "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty int64 x\nend_header\n");
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(colors), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 大端文件：填充结构体和字段跨 16 字节边界的记录都能读对
+static void testByteOrder() {
+    const size_t count = 4099;
+    std::vector<TestPadded> expected(count);
+    std::string bytes;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i);
+        TestPadded& p = expected[i];
+        std::memset(&p, 0, sizeof(p));
+        p.x = static_cast<double>(h % 100000) * 0.001;
+        p.y = -static_cast<double>(h >> 20 & 0xffff);
+        p.z = static_cast<double>(i) + 0.5;
+        p.intensity = static_cast<float>(h >> 40 & 0xff) / 256.0f;
+        p.label = static_cast<unsigned short>(h >> 48);
+        appendValue(bytes, p.x, false);
+        appendValue(bytes, p.y, false);
+        appendValue(bytes, p.z, false);
+        appendValue(bytes, p.intensity, false);
+        appendValue(bytes, p.label, false);
+    }
+    const std::string file = dir + "/be.ply";
+    writeRaw(file,
+             "ply\nformat binary_big_endian 1.0\nelement vertex " + std::to_string(count) +
+                 "\nproperty double x\nproperty double y\nproperty double z\nproperty float intensity\n"
+                 "property ushort label\nend_header\n",
+             bytes.data(), bytes.size());
+    std::vector<TestPadded> read;
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, expected));
+    PLY_CHECK(sameVertices(PlyBinaryIO(file).readMapped<TestPadded>(), expected));
+
+    const std::vector<CustomVertex> points = makeCloud(10007);
+    writeBigEndian(file, points);
+    std::vector<CustomVertex> vertices;
+    PlyBinaryIO(file).read(vertices);
+    PLY_CHECK(sameVertices(vertices, points));
+    PLY_CHECK(sameVertices(PlyBinaryIO(file).readMapped<CustomVertex>(), points));
+    ::unlink(file.c_str());
+
+    // 各种记录布局（整周期、逐记录窗口、尾部记录、单字节字段）与逐字段翻转的结果一致，翻转两次还原
+    const std::vector<std::pair<std::vector<std::pair<size_t, size_t>>, size_t>> layouts = {
+        {{{0, 4}, {4, 4}, {8, 4}}, 12},
+        {{{0, 4}, {4, 4}, {8, 4}, {12, 1}, {13, 1}, {14, 1}}, 15},
+        {{{0, 8}, {8, 8}, {16, 8}, {24, 4}, {28, 2}}, 30},
+        {{{0, 2}, {2, 2}, {4, 2}}, 6},
+        {{{0, 1}, {1, 8}, {9, 8}}, 17},
+        {{{0, 1}, {1, 1}}, 2},
+    };
+    for (const auto& layout : layouts) {
+        const EndianSwapper swapper(layout.first, layout.second);
+        for (size_t records : {size_t(0), size_t(1), size_t(7), size_t(1001)}) {
+            std::string data(records * layout.second, '\0');
+            for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<char>(testHash(i));
+            std::string reference = data;
+            for (size_t r = 0; r < records; r++) {
+                for (const auto& field : layout.first) {
+                    char* begin = &reference[r * layout.second + field.first];
+                    std::reverse(begin, begin + field.second);
+                }
+            }
+            std::string swapped = data;
+            swapper.apply(&swapped[0], records);
+            PLY_CHECK(swapped == reference);
+            swapper.apply(&swapped[0], records);
+            PLY_CHECK(swapped == data);
+        }
+    }
+}
+
+// asc 文本：文件被切成多块并行解析；多种分隔符和换行，空行忽略，无效行按文件中的行号报告
+static void testAscFile() {
+    const std::vector<CustomVertex> points = makeCloud(120000, 12);
+    const std::string file = dir + "/cloud.txt";
+    std::vector<size_t> badLines;
+    {
+        std::ofstream out(file, std::ios::binary);
+        out.precision(9);
+        // 颜色取格子中点，解析时乘 255 后截断回原值
+        const auto color = [](unsigned char c) { return (c + 0.5f) / 255.0f; };
+        size_t line = 0;
+        for (size_t i = 0; i < points.size(); i++) {
+            const auto& p = points[i];
+            const char* separator = i % 3 == 0 ? " " : i % 3 == 1 ? "," : "\t";
+            out << p.x << separator << p.y << separator << p.z << separator << color(p.r) << separator
+                << color(p.g) << separator << color(p.b);
+            line++;
+            if (i + 1 == points.size()) break;  // 最后一行没有换行
+            out << (i % 5 == 0 ? "\r\n" : "\n");
+            if (i % 40000 == 100) {
+                out << "1 2 3 0.5 0.5\n";  // 少一个字段
+                badLines.push_back(++line);
+                out << "1 2 3 0.5 0.5 0.5x\n";  // 字段后跟非分隔符
+                badLines.push_back(++line);
+            }
+            if (i % 30000 == 200) {
+                out << " \t\r\n";
+                line++;
+            }
+        }
+    }
+    PLY_CHECK(fileSize(file) > (4 << 20));
+
+    // 结果追加在已有的点后面
+    std::vector<CustomVertex> read(1, points[0]);
+    std::vector<AscParseError> errors;
+    PLY_CHECK(readAscFile(file, read, &errors));
+    std::vector<CustomVertex> expected(1, points[0]);
+    expected.insert(expected.end(), points.begin(), points.end());
+    PLY_CHECK(sameVertices(read, expected));
+    bool linesMatch = errors.size() == badLines.size();
+    for (size_t i = 0; linesMatch && i < errors.size(); i++) linesMatch = errors[i].line == badLines[i];
+    PLY_CHECK(linesMatch);
+    PLY_CHECK(!errors.empty() && errors[0].text == "1 2 3 0.5 0.5");
+
+    // 超出 0~1 的颜色截断到 [0, 255]；空文件没有点；打不开的文件返回 false
+    writeRaw(file, "1 2 3 1.5 -0.5 0 7\r\n");
+    read.clear();
+    PLY_CHECK(readAscFile(file, read) && read.size() == 1 && read[0].r == 255 && read[0].g == 0 && read[0].z == 3);
+    writeRaw(file, "");
+    read.clear();
+    PLY_CHECK(readAscFile(file, read) && read.empty());
+    PLY_CHECK(!readAscFile(dir + "/missing.txt", read));
+    ::unlink(file.c_str());
+}
+
+// 分批读取：批大小不整除、大于总数或为 0，大端和需要转换的文件；提前停止；截断时报错
+static void testBatches() {
+    const std::vector<CustomVertex> points = makeCloud(100003);
+    const std::string file = dir + "/batches.ply";
+    const std::string bigEndian = dir + "/batches_be.ply";
+    PlyBinaryIO(file).write(points);
+    writeBigEndian(bigEndian, points);
+    for (const std::string& path : {file, bigEndian}) {
+        for (size_t batchSize : {size_t(4096), size_t(1000000), size_t(0)}) {
+            std::vector<CustomVertex> batched;
+            size_t largest = 0, calls = 0;
+            const size_t done = PlyBinaryIO(path).readBatches<CustomVertex>(batchSize, [&](PlyVertexView<CustomVertex> batch) {
+                largest = std::max(largest, batch.size());
+                calls++;
+                batched.insert(batched.end(), batch.begin(), batch.end());
+            });
+            PLY_CHECK(done == points.size() && sameVertices(batched, points));
+            PLY_CHECK(largest == std::min(std::max<size_t>(batchSize, 1), points.size()));
+            PLY_CHECK(calls == (points.size() + largest - 1) / largest);
+        }
+    }
+
+    // 转换读取：只取坐标
+    std::vector<TestDouble> positions;
+    PlyBinaryIO(bigEndian).readBatches<TestDouble>(777, [&](PlyVertexView<TestDouble> batch) {
+        positions.insert(positions.end(), batch.begin(), batch.end());
+    });
+    bool match = positions.size() == points.size();
+    for (size_t i = 0; match && i < points.size(); i++) {
+        match = positions[i].x == points[i].x && positions[i].y == points[i].y && positions[i].z == points[i].z;
+    }
+    PLY_CHECK(match);
+
+    // 回调返回 false 后不再读取，返回值是已交给回调的顶点数
+    size_t seen = 0;
+    PLY_CHECK(PlyBinaryIO(file).readBatches<CustomVertex>(1000, [&](PlyVertexView<CustomVertex> batch) {
+        seen += batch.size();
+        return seen < 3000;
+    }) == 3000);
+    PLY_CHECK(seen == 3000);
+
+    // 空文件不调用回调；截断的文件在读到缺失的批次时报错，之前的批次已经交出
+    PlyBinaryIO(file).write(std::vector<CustomVertex>());
+    PLY_CHECK(PlyBinaryIO(file).readBatches<CustomVertex>(16, [&](PlyVertexView<CustomVertex>) { seen = 0; }) == 0);
+    PLY_CHECK(seen == 3000);
+    PLY_CHECK(::truncate(bigEndian.c_str(), fileSize(bigEndian) - 15 * 5000) == 0);
+    seen = 0;
+    PLY_CHECK_THROWS(PlyBinaryIO(bigEndian).readBatches<CustomVertex>(4096, [&](PlyVertexView<CustomVertex> batch) {
+        seen += batch.size();
+    }), std::runtime_error);
+    PLY_CHECK(seen == 94208);
+    ::unlink(file.c_str());
+    ::unlink(bigEndian.c_str());
+}
+
+// 区间读取：同一个 PlyReader 被多个线程同时使用；越界和溢出的区间、超过 4KB 的头部、截断的尾部
+static void testRangeRead() {
+    const std::vector<CustomVertex> points = makeCloud(100000);
+    const std::string file = dir + "/range.ply";
+    writeBigEndian(file, points);
+    const PlyReader reader(file);
+    std::vector<std::vector<CustomVertex>> parts(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < parts.size(); t++) {
+        threads.emplace_back([&, t] { reader.readRange(t * 25000, 25000, parts[t]); });
+    }
+    for (auto& thread : threads) thread.join();
+    std::vector<CustomVertex> joined;
+    for (const auto& part : parts) joined.insert(joined.end(), part.begin(), part.end());
+    PLY_CHECK(sameVertices(joined, points));
+
+    std::vector<TestDouble> converted(3);
+    reader.readRange(99997, 3, converted.data());
+    PLY_CHECK(converted[2].x == points[99999].x && converted[2].z == points[99999].z);
+    std::vector<CustomVertex> range;
+    reader.readRange(100000, 0, range);
+    PLY_CHECK(range.empty());
+    PLY_CHECK_THROWS(reader.readRange(99999, 2, range), std::out_of_range);
+    PLY_CHECK_THROWS(reader.readRange(100001, 0, range), std::out_of_range);
+    PLY_CHECK_THROWS(reader.readRange(1, SIZE_MAX, range), std::out_of_range);
+
+    // 头部超过第一次读取的 4KB
+    std::string comments;
+    for (int i = 0; i < 500; i++) comments += "comment padding line " + std::to_string(i) + "\n";
+    writeRaw(file,
+             "ply\nformat binary_little_endian 1.0\n" + comments +
+                 "element vertex 100000\nproperty float x\nproperty float y\nproperty float z\n"
+                 "property uchar r\nproperty uchar g\nproperty uchar b\nend_header\n",
+             points.data(), points.size() * sizeof(CustomVertex));
+    for (size_t threadCount : {size_t(1), size_t(3)}) {
+        std::vector<CustomVertex> read;
+        PlyReader(file).read(read, threadCount);
+        PLY_CHECK(sameVertices(read, points));
+    }
+
+    // 截断：前面的区间照常读取，缺失的部分报错
+    PLY_CHECK(::truncate(file.c_str(), fileSize(file) - 1) == 0);
+    const PlyReader truncated(file);
+    truncated.readRange(0, 99999, range);
+    PLY_CHECK(sameVertices(range, std::vector<CustomVertex>(points.begin(), points.end() - 1)));
+    PLY_CHECK_THROWS(truncated.readRange(99999, 1, range), std::runtime_error);
+    PLY_CHECK_THROWS(truncated.read(range), std::runtime_error);
+
+    writeRaw(file, "ply\nformat binary_little_endian 1.0\nelement vertex 0\n");
+    PLY_CHECK_THROWS(PlyReader{file}, std::runtime_error);
+    writeRaw(file, "ply\nformat ascii 1.0\nelement vertex 0\nproperty float x\nend_header\n");
+    PLY_CHECK_THROWS(PlyReader{file}, std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 按列读写：大端文件跨多个块解交错；列类型与文件不同时转换，文件没有的列置零；列名和类型错误报错
+static void testColumns() {
+    const std::vector<CustomVertex> points = makeCloud(150001, 1);
+    const std::string file = dir + "/columns.ply";
+    writeBigEndian(file, points);
+    const PlyColumns columns = PlyReader(file).readColumns<CustomVertex>();
+    PLY_CHECK(columns.rows() == points.size() && columns.columns().size() == 6);
+    bool match = true;
+    for (size_t i = 0; match && i < points.size(); i++) {
+        match = columns.column<float>("y")[i] == points[i].y && columns.column<unsigned char>("g")[i] == points[i].g;
+    }
+    PLY_CHECK(match);
+
+    PlyColumns custom;
+    custom.addColumn("z", PropertyType::DOUBLE);
+    custom.addColumn("r", PropertyType::FLOAT);
+    custom.addColumn("nx", PropertyType::SHORT);
+    PlyBinaryIO(file).readColumns(custom);
+    PLY_CHECK(custom.rows() == points.size());
+    PLY_CHECK(custom.column<double>("z")[150000] == points[150000].z && custom.column<float>("r")[7] == points[7].r);
+    PLY_CHECK(custom.column<short>("nx")[4321] == 0);
+    PLY_CHECK_THROWS(custom.addColumn("z", PropertyType::FLOAT), std::invalid_argument);
+    PLY_CHECK_THROWS(custom.addColumn("w", PropertyType::UNKNOWN), std::invalid_argument);
+    PLY_CHECK_THROWS(custom.column<float>("z"), std::invalid_argument);
+    PLY_CHECK_THROWS(custom.column<float>("w"), std::out_of_range);
+
+    // 写回：属性顺序即列顺序，按名字读回结构体
+    const std::string copy = dir + "/columns_copy.ply";
+    PlyBinaryIO(copy).writeColumns(columns);
+    std::vector<CustomVertex> read;
+    PlyBinaryIO(copy).read(read);
+    PLY_CHECK(sameVertices(read, points));
+    PlyBinaryIO(copy).writeColumns(custom);
+    PLY_CHECK(PlyReader(copy).header().vertexSize() == 14 && PlyReader(copy).header().properties[0].name == "z");
+    PlyBinaryIO(copy).writeColumns(PlyColumns::forVertex<CustomVertex>());
+    PLY_CHECK(PlyReader(copy).vertexCount() == 0 && PlyReader(copy).readColumns<CustomVertex>().rows() == 0);
+    ::unlink(file.c_str());
+    ::unlink(copy.c_str());
+}
+
+// 宽记录（坐标后面有 64 字节的其他属性）：投影读取只取用到的字段
+static void writeWide(const std::string& file, const std::vector<CustomVertex>& points, bool littleEndian) {
+    std::string bytes;
+    for (size_t i = 0; i < points.size(); i++) {
+        appendValue(bytes, points[i].x, littleEndian);
+        appendValue(bytes, points[i].y, littleEndian);
+        appendValue(bytes, points[i].z, littleEndian);
+        for (int k = 0; k < 8; k++) appendValue(bytes, static_cast<double>(i * 8 + k), littleEndian);
+    }
+    std::string header = std::string("ply\nformat ") + (littleEndian ? "binary_little_endian" : "binary_big_endian") +
+                         " 1.0\nelement vertex " + std::to_string(points.size()) +
+                         "\nproperty float x\nproperty float y\nproperty float z\n";
+    for (int k = 0; k < 8; k++) header += "property double extra" + std::to_string(k) + "\n";
+    writeRaw(file, header + "end_header\n", bytes.data(), bytes.size());
+}
+
+// 投影读取：列按请求顺序、保持文件类型；宽记录直接从映射内存取字段，大端走缓冲区；截断和不存在的属性报错
+static void testProjection() {
+    const std::vector<CustomVertex> points = makeCloud(70001, 1);
+    const std::string file = dir + "/projection.ply";
+    for (bool littleEndian : {true, false}) {
+        writeWide(file, points, littleEndian);
+        const PlyColumns projected = PlyReader(file).readColumns({"extra7", "z"});
+        PLY_CHECK(projected.columns().size() == 2 && projected.columns()[0].property.name == "extra7");
+        PLY_CHECK(projected.column<double>("extra7")[70000] == 70000 * 8 + 7);
+        PLY_CHECK(projected.column<float>("z")[999] == points[999].z);
+
+        std::vector<TestDouble> positions;
+        PlyReader(file).read(positions, 3);
+        bool match = positions.size() == points.size();
+        for (size_t i = 0; match && i < points.size(); i++) {
+            match = positions[i].x == points[i].x && positions[i].y == points[i].y && positions[i].z == points[i].z;
+        }
+        PLY_CHECK(match);
+        std::vector<TestDouble> range;
+        PlyReader(file).readRange(65535, 2, range);
+        PLY_CHECK(range.size() == 2 && range[1].y == points[65536].y);
+        PLY_CHECK_THROWS(PlyReader(file).readColumns({"z", "w"}), std::out_of_range);
+    }
+    PLY_CHECK(::truncate(file.c_str(), fileSize(file) - 1) == 0);
+    std::vector<TestDouble> positions;
+    PLY_CHECK_THROWS(PlyReader(file).read(positions), std::runtime_error);
+    writeWide(file, points, true);
+    PLY_CHECK(::truncate(file.c_str(), fileSize(file) - 1) == 0);
+    PLY_CHECK_THROWS(PlyReader(file).read(positions), std::runtime_error);
+    PLY_CHECK_THROWS(PlyReader(file).readColumns({"x"}), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 多线程写入：有填充的结构体去掉填充，大端输出逐字节正确；覆盖更大的旧文件时长度正确
+static void testParallelWrite() {
+    const size_t count = 70001;
+    std::vector<TestPadded> padded(count);
+    std::string expected;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i);
+        std::memset(&padded[i], 0x5a, sizeof(TestPadded));  // 填充字节不能进入文件
+        padded[i].x = static_cast<double>(h % 100000) * 0.001;
+        padded[i].y = static_cast<double>(h >> 20 & 0xffff) * 0.01;
+        padded[i].z = -static_cast<double>(i);
+        padded[i].intensity = static_cast<float>(h >> 40 & 0xff) / 255.0f;
+        padded[i].label = static_cast<unsigned short>(h >> 48);
+        appendValue(expected, padded[i].x, false);
+        appendValue(expected, padded[i].y, false);
+        appendValue(expected, padded[i].z, false);
+        appendValue(expected, padded[i].intensity, false);
+        appendValue(expected, padded[i].label, false);
+    }
+    const std::vector<CustomVertex> points = makeCloud(100000);
+    const std::string file = dir + "/parallel.ply";
+    for (size_t threads : {size_t(1), size_t(4)}) {
+        PlyWriteOptions options;
+        options.threads = threads;
+        options.littleEndian = false;
+        PlyBinaryIO(file).write(padded, options);
+        const size_t dataOffset = PlyReader(file).header().dataOffset;
+        PLY_CHECK(fileSize(file) == dataOffset + count * 30);
+        PLY_CHECK(readTail(file, dataOffset) == expected);
+        std::vector<TestPadded> paddedRead;
+        PlyBinaryIO(file).read(paddedRead);
+        PLY_CHECK(sameVertices(paddedRead, padded));
+
+        options.littleEndian = true;
+        PlyBinaryIO(file).write(points, options);
+        PLY_CHECK(fileSize(file) == PlyReader(file).header().dataOffset + points.size() * 15);
+        std::vector<CustomVertex> read;
+        PlyBinaryIO(file).read(read);
+        PLY_CHECK(sameVertices(read, points));
+
+        PlyBinaryIO(file).writeColumns(PlyReader(file).readColumns({"b", "x"}), options);
+        const PlyColumns columns = PlyReader(file).readColumns({"x", "b"});
+        PLY_CHECK(fileSize(file) == PlyReader(file).header().dataOffset + points.size() * 5);
+        PLY_CHECK(columns.column<float>("x")[99999] == points[99999].x && columns.column<unsigned char>("b")[5] == points[5].b);
+
+        PlyBinaryIO(file).write(std::vector<CustomVertex>(), options);
+        PLY_CHECK(fileSize(file) == PlyReader(file).header().dataOffset && PlyReader(file).vertexCount() == 0);
+    }
+    PLY_CHECK_THROWS(PlyBinaryIO(dir + "/missing/parallel.ply").write(points), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 追加写入：批次跨越缓冲区边界；flush 后不关闭文件也可读；关闭后再追加报错；中途退出的文件可以修复
+static void testAppend() {
+    const std::vector<CustomVertex> points = makeCloud(40000, 4);
+    const std::string file = dir + "/append.ply";
+    {
+        PlyWriteOptions options;
+        options.littleEndian = false;
+        PlyAppendWriter<CustomVertex> writer(file, options, 1000);
+        for (size_t first = 0; first < 20000; first += 777) {
+            writer.append(points.data() + first, std::min<size_t>(777, 20000 - first));
+        }
+        PLY_CHECK(writer.count() == 20000);
+        writer.flush();
+        std::vector<CustomVertex> partial;
+        PlyBinaryIO(file).read(partial);
+        PLY_CHECK(sameVertices(partial, std::vector<CustomVertex>(points.begin(), points.begin() + 20000)));
+        writer.append(std::vector<CustomVertex>(points.begin() + 20000, points.end()));
+        // 析构时写完剩余的顶点
+    }
+    std::vector<CustomVertex> read;
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, points));
+
+    // 有填充的结构体按去掉填充的记录写出
+    const std::string paddedFile = dir + "/append_padded.ply";
+    std::vector<TestPadded> padded(3001);
+    for (size_t i = 0; i < padded.size(); i++) {
+        std::memset(&padded[i], 0, sizeof(TestPadded));
+        padded[i].x = static_cast<double>(i);
+        padded[i].label = static_cast<unsigned short>(i * 7);
+    }
+    {
+        PlyAppendWriter<TestPadded> writer(paddedFile, PlyWriteOptions(), 256);
+        writer.append(padded);
+        writer.close();
+        PLY_CHECK_THROWS(writer.append(padded), std::logic_error);
+    }
+    PLY_CHECK(fileSize(paddedFile) == PlyReader(paddedFile).header().dataOffset + padded.size() * 30);
+    std::vector<TestPadded> paddedRead;
+    PlyBinaryIO(paddedFile).read(paddedRead);
+    PLY_CHECK(sameVertices(paddedRead, padded));
+
+    // 模拟中途退出：顶点数字段清零，末尾多出一条已落盘的记录和半条记录
+    const PlyHeader header = PlyReader(file).header();
+    std::string text(header.dataOffset, '\0');
+    {
+        std::fstream patch(file, std::ios::in | std::ios::out | std::ios::binary);
+        patch.read(&text[0], text.size());
+        const size_t offset = text.find("element vertex ") + std::strlen("element vertex ");
+        const size_t width = text.find('\n', offset) - offset;
+        PLY_CHECK(width == PlyAppendWriter<CustomVertex>::kCountWidth);
+        patch.seekp(offset);
+        patch << std::string(width, '0');
+        patch.seekp(0, std::ios::end);
+        std::string extra = readTail(file, header.dataOffset).substr(0, 15);
+        patch.write(extra.data(), extra.size());
+        patch.write("\1\2\3\4", 4);
+    }
+    std::vector<CustomVertex> expected = points;
+    expected.push_back(points[0]);
+    PLY_CHECK(recoverAppendedPly(file) == expected.size());
+    read.clear();
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, expected));
+    PLY_CHECK(PlyReader(file).header().dataOffset == header.dataOffset);
+
+    // 普通文件的顶点数字段放不下实际数量时报错，不改动文件
+    PlyBinaryIO(file).write(std::vector<CustomVertex>(points.begin(), points.begin() + 5));
+    {
+        std::ofstream grow(file, std::ios::binary | std::ios::app);
+        grow.write(reinterpret_cast<const char*>(points.data()), 10 * sizeof(CustomVertex));
+    }
+    const size_t size = fileSize(file);
+    PLY_CHECK_THROWS(recoverAppendedPly(file), std::runtime_error);
+    PLY_CHECK(fileSize(file) == size && PlyReader(file).vertexCount() == 5);
+    ::unlink(file.c_str());
+    ::unlink(paddedFile.c_str());
+}
+
+// 混合三角形和多边形的面片（列表长度不一）
+static PlyFaceList makeFaces(size_t vertexCount, bool trianglesOnly = false) {
+    PlyFaceList faces;
+    faces.offsets.push_back(0);
+    for (uint32_t i = 0; i + 5 < vertexCount; i += 3) {
+        const uint32_t n = i % 7 == 0 && !trianglesOnly ? 5 : 3;
+        for (uint32_t k = 0; k < n; k++) faces.indices.push_back(i + k);
+        faces.offsets.push_back(faces.indices.size());
+    }
+    return faces;
+}
+
+// 面片：等长和不等长的列表、两种字节序；vertex 前面有变长元素；负数的列表长度报错，推测位置读到负数时不报错
+static void testFaces() {
+    const std::vector<CustomVertex> points = makeCloud(5000, 3);
+    const std::string file = dir + "/faces.ply";
+    for (bool trianglesOnly : {true, false}) {
+        const PlyFaceList faces = makeFaces(points.size(), trianglesOnly);
+        for (bool littleEndian : {true, false}) {
+            PlyWriteOptions options;
+            options.littleEndian = littleEndian;
+            PlyBinaryIO(file).write(points, faces, options);
+            PlyFaceList read;
+            PlyReader(file).readFaces(read, "face", "vertex_indices", 3);
+            PLY_CHECK(read.offsets == faces.offsets && read.indices == faces.indices);
+            std::vector<CustomVertex> vertices;
+            PlyReader(file).read(vertices);
+            PLY_CHECK(sameVertices(vertices, points));
+        }
+    }
+
+    // face 在 vertex 前面，中间还有一个定长元素
+    struct Camera {
+        float focal;
+        REFLECTABLE(MEMBER_INFO(Camera, focal, float))
+    };
+    std::string bytes;
+    appendValue(bytes, static_cast<unsigned char>(3));
+    for (int32_t k : {0, 1, 2}) appendValue(bytes, k);
+    appendValue(bytes, static_cast<unsigned char>(4));
+    for (int32_t k : {3, 2, 1, 0}) appendValue(bytes, k);
+    appendValue(bytes, 35.0f);
+    bytes.append(reinterpret_cast<const char*>(points.data()), 4 * sizeof(CustomVertex));
+    writeRaw(file,
+             "ply\nformat binary_little_endian 1.0\nelement face 2\nproperty list uchar int vertex_indices\n"
+             "element camera 1\nproperty float focal\nelement vertex 4\nproperty float x\nproperty float y\n"
+             "property float z\nproperty uchar r\nproperty uchar g\nproperty uchar b\nend_header\n",
+             bytes.data(), bytes.size());
+    std::vector<CustomVertex> vertices;
+    PlyReader(file).read(vertices);
+    PLY_CHECK(sameVertices(vertices, std::vector<CustomVertex>(points.begin(), points.begin() + 4)));
+    std::vector<Camera> cameras;
+    PlyReader(file).readElement("camera", cameras);
+    PLY_CHECK(cameras.size() == 1 && cameras[0].focal == 35.0f);
+    PlyFaceList read;
+    PlyReader(file).readFaces(read);
+    PLY_CHECK(read.offsets == std::vector<uint64_t>({0, 3, 7}) && read.indices == std::vector<uint32_t>({0, 1, 2, 3, 2, 1, 0}));
+    PLY_CHECK_THROWS(PlyReader(file).readElement("face", cameras), std::runtime_error);
+
+    // 前一半是三角形、后一半是四边形：从后一半开始验证的线程按三角形长度推测的位置落在记录中间，
+    // 读到的长度字节是 -1，只能说明推测不成立
+    bytes.clear();
+    for (int i = 0; i < 200000; i++) {
+        const bool triangle = i < 100000;
+        appendValue(bytes, static_cast<signed char>(triangle ? 3 : 4));
+        for (int k = 0; k < (triangle ? 3 : 4); k++) appendValue(bytes, int32_t(triangle ? k : -1));
+    }
+    const std::string faceHeader =
+        "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty float x\nelement face 200000\n"
+        "property list char int vertex_indices\nend_header\n";
+    writeRaw(file, faceHeader, bytes.data(), bytes.size());
+    PlyReader(file).readFaces(read);
+    PLY_CHECK(read.size() == 200000 && read.offsets.back() == 100000 * 7 && read.indices.back() == 0xffffffffu);
+
+    // 真正的负数长度报错
+    bytes[13 * 100000 + 17 * 500] = static_cast<char>(-4);
+    writeRaw(file, faceHeader, bytes.data(), bytes.size());
+    PLY_CHECK_THROWS(PlyReader(file).readFaces(read), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 编译期描述：只有按内存顺序紧密注册全部字节的结构体才整体拷贝；属性文本和文件记录按注册顺序
+static void testSchema() {
+    static_assert(PlySchema<CustomVertex>::isPacked, "CustomVertex 没有填充");
+    static_assert(PlySchema<TestDouble>::isPacked, "TestDouble 没有填充");
+    static_assert(!PlySchema<TestPadded>::isPacked, "TestPadded 有填充");
+    static_assert(!PlySchema<TestReordered>::isPacked, "TestReordered 注册顺序与内存顺序不同");
+    static_assert(!PlySchema<TestPartial>::isPacked, "TestPartial 有未注册的成员");
+    static_assert(PlySchema<TestPadded>::count == 5, "TestPadded 有 5 个成员");
+    PLY_CHECK(PlySchema<TestDouble>::properties() == "property double x\nproperty double y\nproperty double z\n");
+    PLY_CHECK(PlySchema<TestReordered>::properties() == "property int id\nproperty float x\nproperty float y\n");
+
+    const std::string file = dir + "/schema.ply";
+    std::vector<TestReordered> reordered(1001);
+    for (size_t i = 0; i < reordered.size(); i++) reordered[i] = TestReordered{i * 0.5f, -1.0f * i, static_cast<int>(i)};
+    PlyBinaryIO(file).write(reordered);
+    std::string expected;
+    for (const auto& p : reordered) {
+        appendValue(expected, p.id);
+        appendValue(expected, p.x);
+        appendValue(expected, p.y);
+    }
+    PLY_CHECK(readTail(file, PlyReader(file).header().dataOffset) == expected);
+    std::vector<TestReordered> read;
+    PlyBinaryIO(file).read(read);
+    bool match = read.size() == reordered.size();
+    for (size_t i = 0; match && i < read.size(); i++) {
+        match = read[i].id == reordered[i].id && read[i].x == reordered[i].x && read[i].y == reordered[i].y;
+    }
+    PLY_CHECK(match);
+
+    std::vector<TestPartial> partial(3, TestPartial{1, 2, 3, 99});
+    PlyBinaryIO(file).write(partial);
+    PLY_CHECK(fileSize(file) == PlyReader(file).header().dataOffset + 3 * 12);
+    std::vector<TestPartial> partialRead;
+    PlyBinaryIO(file).read(partialRead);
+    PLY_CHECK(partialRead.size() == 3 && partialRead[0].x == 1 && partialRead[2].z == 3);
+    ::unlink(file.c_str());
+}
+
+// ASCII PLY：浮点数最短往返文本读回逐位相同；有填充的结构体；vertex 前面的元素、CRLF 和多余空白；
+// 截断和无法解析的行报错；追加写入器拒绝 ASCII 且不截断已有文件
+static void testAscii() {
+    std::vector<TestPadded> padded(3001);
+    for (size_t i = 0; i < padded.size(); i++) {
+        const uint64_t h = testHash(i);
+        std::memset(&padded[i], 0, sizeof(TestPadded));
+        padded[i].x = static_cast<double>(h) / 3.0;
+        padded[i].y = -1e-300 * static_cast<double>(i);
+        padded[i].z = 0.1 * static_cast<double>(i);
+        padded[i].intensity = static_cast<float>(h >> 40) / 7.0f;
+        padded[i].label = static_cast<unsigned short>(h >> 48);
+    }
+    const std::string file = dir + "/ascii.ply";
+    PlyWriteOptions options;
+    options.ascii = true;
+    PlyBinaryIO(file).write(padded, options);
+    std::vector<TestPadded> paddedRead;
+    PlyBinaryIO(file).read(paddedRead);
+    PLY_CHECK(sameVertices(paddedRead, padded));
+    PLY_CHECK_THROWS(PlyReader{file}, std::runtime_error);
+
+    const std::vector<CustomVertex> points = makeCloud(30000, 2);
+    const PlyFaceList faces = makeFaces(points.size());
+    PlyBinaryIO(file).write(points, faces, options);
+    std::vector<CustomVertex> read;
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, points));
+
+    // 手写的文件：vertex 前面有两个元素，CRLF，行首行尾有空白
+    const std::string text =
+        "ply\r\nformat ascii 1.0\r\nelement face 2\r\nproperty list uchar int vertex_indices\r\n"
+        "element camera 1\r\nproperty float focal\r\nelement vertex 3\r\nproperty float x\r\n"
+        "property float y\r\nproperty float z\r\nproperty uchar r\r\nend_header\r\n"
+        "3 0 1 2\r\n4 0 1 2 0\r\n35\r\n1 2 3 4\r\n  5.5\t6 7 8  \r\n-1 -2 -3 255";
+    writeRaw(file, text);
+    read.clear();
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(read.size() == 3 && read[1].x == 5.5f && read[1].r == 8 && read[2].z == -3 && read[2].r == 255 && read[2].g == 0);
+
+    writeRaw(file, text.substr(0, text.rfind("\r\n")));
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(read), std::runtime_error);
+    std::string bad = text;
+    bad.replace(bad.find("5.5"), 3, "5.x");
+    writeRaw(file, bad);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(read), std::runtime_error);
+
+    // 二进制文件经同一映射交给 PlyReader：vertex 前面有变长元素时也要找到数据起点
+    PlyWriteOptions binary;
+    PlyBinaryIO(file).write(points, faces, binary);
+    std::string moved;
+    {
+        const PlyReader reader(file);
+        const PlyElement& face = reader.header().elements[1];
+        const std::string tail = readTail(file, reader.header().dataOffset);
+        const size_t vertexBytes = points.size() * sizeof(CustomVertex);
+        moved = "ply\nformat binary_little_endian 1.0\nelement face " + std::to_string(face.count) +
+                "\nproperty list uchar uint vertex_indices\nelement vertex " + std::to_string(points.size()) +
+                "\n" + std::string(PlySchema<CustomVertex>::properties()) + "end_header\n" + tail.substr(vertexBytes) +
+                tail.substr(0, vertexBytes);
+    }
+    writeRaw(file, moved);
+    read.clear();
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(sameVertices(read, points));
+
+    const size_t size = fileSize(file);
+    PLY_CHECK_THROWS(PlyAppendWriter<CustomVertex>(file, options), std::invalid_argument);
+    PLY_CHECK(fileSize(file) == size);
+    ::unlink(file.c_str());
+}
+
+static bool lessVertex(const CustomVertex& a, const CustomVertex& b) {
+    return std::tie(a.x, a.y, a.z, a.r, a.g, a.b) < std::tie(b.x, b.y, b.z, b.r, b.g, b.b);
+}
+
+// 按内容排序后比较，用于不保持顺序的读写
+static bool sameSet(std::vector<CustomVertex> a, std::vector<CustomVertex> b) {
+    std::sort(a.begin(), a.end(), lessVertex);
+    std::sort(b.begin(), b.end(), lessVertex);
+    return sameVertices(a, b);
+}
+
+template<typename VertexType>
+static std::vector<VertexType> insideBox(const std::vector<VertexType>& points, const PlyBounds& box) {
+    std::vector<VertexType> inside;
+    for (const auto& p : points) {
+        const PlyPosition position{static_cast<float>(p.x), static_cast<float>(p.y), static_cast<float>(p.z)};
+        if (box.contains(position)) inside.push_back(p);
+    }
+    return inside;
+}
+
+// 包围盒查询：与逐点筛选一致（含落在边界上的点）；同样大小的改写（本库写入或外部改写）和损坏的索引都不会被使用
+static void testBoxQuery() {
+    const std::string file = dir + "/box.ply";
+    const std::string sidecar = PlyChunkIndex::sidecarPath(file);
+    PlyBounds box;
+    box.min = {{10, 20, 0}};
+    box.max = {{30, 40, 8}};
+    std::vector<CustomVertex> points = makeCloud(100000, 6);
+    PlyBinaryIO(file).write(points);
+    PLY_CHECK(!fileExists(sidecar));
+    std::vector<CustomVertex> hits;
+    PLY_CHECK(PlyBinaryIO(file).readBox(box, hits) == insideBox(points, box).size());
+    PLY_CHECK(sameVertices(hits, insideBox(points, box)));
+    PLY_CHECK(fileExists(sidecar));
+    PLY_CHECK(PlyBinaryIO(file).readBox(box, hits) == insideBox(points, box).size());
+
+    // 本库改写文件时删除索引；外部改写同样大小的文件时索引的时间戳不再匹配
+    for (auto& p : points) p.x += 5;
+    PlyBinaryIO(file).write(points);
+    PLY_CHECK(!fileExists(sidecar));
+    PlyBinaryIO(file).readBox(box, hits);
+    PLY_CHECK(sameVertices(hits, insideBox(points, box)));
+    for (auto& p : points) p.y -= 3;
+    {
+        const std::string header = readTail(file, 0).substr(0, PlyReader(file).header().dataOffset);
+        writeRaw(file, header, points.data(), points.size() * sizeof(CustomVertex));
+    }
+    PLY_CHECK(fileExists(sidecar));
+    PlyBinaryIO(file).readBox(box, hits);
+    PLY_CHECK(sameVertices(hits, insideBox(points, box)));
+
+    // 损坏的索引文件被忽略并重建
+    for (size_t size : {size_t(0), size_t(20), size_t(100)}) {
+        PLY_CHECK(::truncate(sidecar.c_str(), static_cast<off_t>(size)) == 0);
+        PlyBinaryIO(file).readBox(box, hits);
+        PLY_CHECK(sameVertices(hits, insideBox(points, box)));
+    }
+
+    // 与所有点都不相交的盒子；坐标需要转换的文件
+    PlyBounds far;
+    far.min = {{1000, 1000, 1000}};
+    far.max = {{2000, 2000, 2000}};
+    PLY_CHECK(PlyBinaryIO(file).readBox(far, hits) == 0 && hits.empty());
+    std::vector<TestPadded> padded(20000);
+    for (size_t i = 0; i < padded.size(); i++) {
+        std::memset(&padded[i], 0, sizeof(TestPadded));
+        padded[i].x = points[i].x, padded[i].y = points[i].y, padded[i].z = points[i].z;
+        padded[i].label = static_cast<unsigned short>(i);
+    }
+    PlyBinaryIO(file).write(padded);
+    std::vector<TestPadded> paddedHits;
+    PlyBinaryIO(file).readBox(box, paddedHits);
+    PLY_CHECK(sameVertices(paddedHits, insideBox(padded, box)));
+
+    writeRaw(file, "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty float x\nproperty float y\nend_header\n");
+    PLY_CHECK_THROWS(PlyBinaryIO(file).readBox(box, hits), std::runtime_error);
+    ::unlink(file.c_str());
+    ::unlink(sidecar.c_str());
+}
+
+// 按 label 找回原来的点，检查坐标误差都不超过 step / 2
+static bool withinStep(const std::vector<TestPadded>& read, const std::vector<TestPadded>& points, double step) {
+    if (read.size() != points.size()) return false;
+    for (const auto& p : read) {
+        const TestPadded& original = points[p.label];
+        if (std::abs(p.x - original.x) > step * 0.5000001 || std::abs(p.y - original.y) > step * 0.5000001 ||
+            std::abs(p.z - original.z) > step * 0.5000001 || p.intensity != original.intensity) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 量化压缩：顺序改变、坐标误差不超过半个精度（块内范围远超 2^21 个精度单位时也是）；
+// 被拒绝的写入不截断已有文件，截断的文件报错
+static void testQuantized() {
+    const std::string file = dir + "/quantized.ply";
+    const std::vector<CustomVertex> points = makeCloud(150000, 2);
+    PlyWriteOptions options;
+    options.quantization = 1.0 / 1024;
+    PlyBinaryIO(file).write(points, options);
+    const std::string bytes = readTail(file, 0);
+    PLY_CHECK(parseHeader(bytes.data(), bytes.size()).quantized);
+    PLY_CHECK(fileSize(file) < points.size() * sizeof(CustomVertex));
+    std::vector<CustomVertex> read;
+    PlyBinaryIO(file).read(read);
+    PLY_CHECK(read.size() == points.size());
+    bool withinPrecision = true;
+    for (auto& p : read) {
+        for (float* value : {&p.x, &p.y, &p.z}) {
+            const float snapped = std::round(*value * 64.0f) / 64.0f;
+            withinPrecision = withinPrecision && std::abs(snapped - *value) <= 1.0f / 2048;
+            *value = snapped;
+        }
+    }
+    PLY_CHECK(withinPrecision);
+    PLY_CHECK(sameSet(read, points));
+    PLY_CHECK_THROWS(PlyReader reader(file), std::runtime_error);
+
+    // 1 mm 精度、10 km 范围：每块要切成多个单元，不能放大精度
+    std::vector<TestPadded> wide(1000);
+    for (size_t i = 0; i < wide.size(); i++) {
+        std::memset(&wide[i], 0, sizeof(TestPadded));
+        const uint64_t h = testHash(i);
+        wide[i].x = static_cast<double>(h % 10000000) / 1000 + 0.0001 * (h >> 60);
+        wide[i].y = static_cast<double>(h >> 24 & 1023) / 7;
+        wide[i].z = -static_cast<double>(h >> 40 & 255);
+        wide[i].intensity = static_cast<float>(i);
+        wide[i].label = static_cast<unsigned short>(i);
+    }
+    // 单元边界两侧的点，以及单元内最大的差值
+    const double step = 0.001;
+    const double cell = step * (PlyQuantizedCodec::kMaxCode + 1);
+    const double edges[][3] = {{0, 0, 0}, {cell - step, cell - step, cell - step}, {cell, 0, 0}, {cell + step, cell, -cell}};
+    for (size_t i = 0; i < 4; i++) {
+        wide[i].x = edges[i][0], wide[i].y = edges[i][1], wide[i].z = edges[i][2];
+    }
+    options.quantization = step;
+    PlyBinaryIO(file).write(wide, options);
+    std::vector<TestPadded> wideRead;
+    PlyBinaryIO(file).read(wideRead);
+    PLY_CHECK(withinStep(wideRead, wide, step));
+    options.quantization = 1e-12;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(wide, options), std::invalid_argument);
+    options.quantization = step;
+    PlyBinaryIO(file).write(std::vector<TestPadded>(), options);
+    PlyBinaryIO(file).read(wideRead);
+    PLY_CHECK(wideRead.empty());
+
+    // 带面片、没有 z 坐标以及追加写入都在打开输出之前被拒绝
+    PlyBinaryIO(file).write(wide, options);
+    const size_t size = fileSize(file);
+    PlyFaceList faces;
+    faces.offsets = {0, 3};
+    faces.indices = {0, 1, 2};
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(wide, faces, options), std::invalid_argument);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(std::vector<TestReordered>(3), options), std::runtime_error);
+    PLY_CHECK_THROWS(PlyAppendWriter<TestPadded> writer(file, options), std::invalid_argument);
+    PLY_CHECK(fileSize(file) == size);
+    PlyBinaryIO(file).read(wideRead);
+    PLY_CHECK(withinStep(wideRead, wide, step));
+
+    for (size_t cut : {size_t(1), size_t(40), size / 2}) {
+        PLY_CHECK(::truncate(file.c_str(), static_cast<off_t>(size - cut)) == 0);
+        PLY_CHECK_THROWS(PlyBinaryIO(file).read(wideRead), std::runtime_error);
+    }
+    ::unlink(file.c_str());
+}
+
+// 预读流水线：段按文件顺序交给单个处理线程，多个处理线程时每段恰好处理一次；
+// 缓冲区远少于段数时提前停止、处理抛出异常、文件被截断都不会卡住 I/O 线程
+static void testReadAhead() {
+    const std::vector<CustomVertex> points = makeCloud(100003, 7);
+    const std::string file = dir + "/read_ahead.ply";
+    writeBigEndian(file, points);
+    for (size_t threads : {size_t(1), size_t(3)}) {
+        std::vector<CustomVertex> read;
+        PlyReader(file).read(read, threads);
+        PLY_CHECK(sameVertices(read, points));
+    }
+
+    const PlyReader reader(file);
+    const std::string raw = readTail(file, reader.header().dataOffset);
+    size_t next = 0;
+    bool inOrder = true;
+    reader.pipeline(1000, 2, 1, [&](size_t first, size_t count, char* data, size_t) {
+        inOrder = inOrder && first == next && std::memcmp(data, raw.data() + first * 15, count * 15) == 0;
+        next = first + count;
+        return true;
+    });
+    PLY_CHECK(inOrder && next == points.size());
+
+    std::mutex mutex;
+    std::vector<int> covered(points.size());
+    reader.pipeline(7, 4, 3, [&](size_t first, size_t count, char*, size_t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = first; i < first + count; i++) covered[i]++;
+        return true;
+    });
+    PLY_CHECK(std::count(covered.begin(), covered.end(), 1) == static_cast<long>(points.size()));
+
+    size_t calls = 0;
+    reader.pipeline(10, 2, 1, [&](size_t, size_t, char*, size_t) { return ++calls < 3; });
+    PLY_CHECK(calls == 3);
+    calls = 0;
+    PLY_CHECK_THROWS(reader.pipeline(10, 2, 2, [&](size_t, size_t, char*, size_t) -> bool {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (++calls == 5) throw std::logic_error("stop");
+        return true;
+    }), std::logic_error);
+
+    // 截断的文件：之前的段照常处理，读到缺失的段时报错
+    PLY_CHECK(::truncate(file.c_str(), static_cast<off_t>(fileSize(file) - 15 * 5000)) == 0);
+    const PlyReader truncated(file);
+    next = 0;
+    PLY_CHECK_THROWS(truncated.pipeline(1000, 3, 1, [&](size_t first, size_t count, char*, size_t) {
+        next = first + count;
+        return true;
+    }), std::runtime_error);
+    PLY_CHECK(next == 95000);
+    std::vector<CustomVertex> read;
+    PLY_CHECK_THROWS(truncated.read(read, 2), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 读写统计：写入字节数等于文件大小，追加写入和转换读取也被统计；读取进行中可以查询；
+// reset 后同一线程继续累加；同一地址上重建的实例不会沿用旧实例的线程缓存
+static void testIOStats() {
+    const std::vector<CustomVertex> points = makeCloud(100000, 11);
+    const std::string file = dir + "/iostats.ply";
+    const std::string bigEndian = dir + "/iostats_be.ply";
+    PlyIOStats stats;
+    PlyWriteOptions options;
+    options.stats = &stats;
+    PlyBinaryIO(file).write(points, options);
+    PLY_CHECK(stats.total().bytesWritten == fileSize(file));
+    PLY_CHECK(stats.total().writeCalls > 0 && stats.total().bytesRead == 0);
+    stats.reset();
+    {
+        PlyAppendWriter<CustomVertex> writer(bigEndian, options, 30000);
+        writer.append(points);
+    }
+    PLY_CHECK(stats.total().bytesWritten >= fileSize(bigEndian));
+    writeBigEndian(bigEndian, points);
+
+    stats.reset();
+    PLY_CHECK(stats.total().syscalls() == 0 && stats.total().bytesWritten == 0);
+    std::atomic<bool> done(false);
+    std::thread watcher([&] {
+        while (!done) stats.total();
+    });
+    std::vector<CustomVertex> read;
+    PlyReader(bigEndian, &stats).read(read, 3);
+    done = true;
+    watcher.join();
+    PLY_CHECK(sameVertices(read, points));
+    const PlyIOStats::Counters total = stats.total();
+    PLY_CHECK(total.bytesRead >= points.size() * 15 && total.readCalls > 0 && total.otherCalls > 0);
+    PLY_CHECK(total.phases[PlyIOStats::kConvert].wall >= 0 && total.phases[PlyIOStats::kConvert].cpu >= 0);
+    PLY_CHECK(!stats.threads().empty());
+
+    std::ostringstream printed;
+    stats.print(printed, true);
+    PLY_CHECK(printed.str().find("total: read ") == 0 && printed.str().find("thread 0: ") != std::string::npos);
+
+    for (int i = 0; i < 3; i++) {
+        auto fresh = std::make_unique<PlyIOStats>();
+        PlyBinaryIO io(file);
+        io.setStats(fresh.get());
+        io.read(read);
+        PLY_CHECK(fresh->total().bytesMapped + fresh->total().bytesRead >= points.size() * 15);
+    }
+    ::unlink(file.c_str());
+    ::unlink(bigEndian.c_str());
+}
+
+// 分配时把内存填成 0xAB，检查读取不依赖内存原有的内容
+template<typename T>
+struct PoisonAllocator : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        using other = PoisonAllocator<U>;
+    };
+    PoisonAllocator() = default;
+    template<typename U>
+    PoisonAllocator(const PoisonAllocator<U>&) {}
+    T* allocate(size_t n) {
+        T* p = std::allocator<T>::allocate(n);
+        std::memset(static_cast<void*>(p), 0xAB, n * sizeof(T));
+        return p;
+    }
+};
+
+// 读入未初始化的存储或调用方提供的缓冲区：文件中没有的字段仍被置零；
+// 缓冲区不够时抛出且不写入；ASCII 和量化文件同样可以读入调用方的缓冲区
+static void testUninitialized() {
+    const std::vector<CustomVertex> points = makeCloud(100000);
+    const std::string file = dir + "/uninitialized.ply";
+    for (bool littleEndian : {true, false}) {
+        PlyWriteOptions options;
+        options.littleEndian = littleEndian;
+        PlyBinaryIO(file).write(points, options);
+        for (size_t threads : {size_t(1), size_t(3)}) {
+            PlyUninitializedVector<CustomVertex> uninitialized;
+            PlyReader(file).read(uninitialized, threads);
+            PLY_CHECK(sameVertices(uninitialized, points));
+        }
+        std::vector<TestPadded, PlyUninitializedAllocator<TestPadded, PoisonAllocator<TestPadded>>> padded;
+        PlyBinaryIO(file).read(padded);
+        bool converted = padded.size() == points.size();
+        for (size_t i = 0; converted && i < points.size(); i++) {
+            converted = padded[i].x == points[i].x && padded[i].z == points[i].z && padded[i].intensity == 0 && padded[i].label == 0;
+        }
+        PLY_CHECK(converted);
+        std::vector<CustomVertex, PlyUninitializedAllocator<CustomVertex, PoisonAllocator<CustomVertex>>> range;
+        PlyReader(file).readRange(99000, 1000, range);
+        PLY_CHECK(range.size() == 1000 && sameVertex(range[0], points[99000]) && sameVertex(range[999], points[99999]));
+
+        std::unique_ptr<CustomVertex[]> buffer(new CustomVertex[points.size()]);
+        PLY_CHECK(PlyBinaryIO(file).read(buffer.get(), points.size()) == points.size());
+        PLY_CHECK(std::equal(points.begin(), points.end(), buffer.get(),
+                             [](const CustomVertex& a, const CustomVertex& b) { return sameVertex(a, b); }));
+    }
+
+    // 缓冲区少一个顶点时抛出，内容不变
+    std::vector<CustomVertex> small(points.size() - 1);
+    small[0].x = -7;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(small.data(), small.size()), std::length_error);
+    PLY_CHECK(small[0].x == -7);
+
+    PlyWriteOptions options;
+    options.ascii = true;
+    PlyBinaryIO(file).write(points, options);
+    std::unique_ptr<CustomVertex[]> buffer(new CustomVertex[points.size() + 10]);
+    PLY_CHECK(PlyBinaryIO(file).read(buffer.get(), points.size() + 10) == points.size());
+    PLY_CHECK(std::equal(points.begin(), points.end(), buffer.get(),
+                         [](const CustomVertex& a, const CustomVertex& b) { return sameVertex(a, b); }));
+    options.ascii = false;
+    options.quantization = 1.0 / 64;
+    PlyBinaryIO(file).write(points, options);
+    PLY_CHECK(PlyBinaryIO(file).read(buffer.get(), points.size()) == points.size());
+    PLY_CHECK(sameSet(std::vector<CustomVertex>(buffer.get(), buffer.get() + points.size()), points));
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(buffer.get(), 10), std::length_error);
+    PlyBinaryIO(file).write(std::vector<CustomVertex>());
+    PLY_CHECK(PlyBinaryIO(file).read(static_cast<CustomVertex*>(nullptr), 0) == 0);
+    ::unlink(file.c_str());
+}
+
+// 批量读取瓦片：字节序、ASCII、量化、vertex 前有面片、没有顶点的文件混在一起，按顺序拼接；
+// 字节序和属性布局相同的文件共用一份转换计划；带列表属性、缺失或截断的文件报错且不改动输出
+static void testBatchReader() {
+    std::vector<std::string> paths;
+    std::vector<CustomVertex> expected;
+    std::vector<uint64_t> starts{0};
+    for (int i = 0; i < 14; i++) {
+        const std::vector<CustomVertex> points = makeCloud(i == 7 ? 0 : 1000 + i * 37, 20 + i);
+        paths.push_back(dir + "/tile" + std::to_string(i) + ".ply");
+        PlyWriteOptions options;
+        options.littleEndian = i % 3 != 0;
+        options.ascii = i == 5;
+        options.quantization = i == 9 ? 1.0 / 64 : 0;
+        if (i == 11) {
+            // 面片在顶点之前，顶点的起始位置要扫描面片才知道
+            std::string bytes;
+            for (int f = 0; f < 2; f++) {
+                appendValue<uint8_t>(bytes, 3);
+                for (int32_t k = 0; k < 3; k++) appendValue<int32_t>(bytes, k + f);
+            }
+            bytes.append(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(CustomVertex));
+            writeRaw(paths.back(), "ply\nformat binary_little_endian 1.0\nelement face 2\nproperty list uchar int vertex_indices\n"
+                                   "element vertex " + std::to_string(points.size()) + "\nproperty float x\nproperty float y\n"
+                                   "property float z\nproperty uchar r\nproperty uchar g\nproperty uchar b\nend_header\n",
+                     bytes.data(), bytes.size());
+        } else {
+            PlyBinaryIO(paths.back()).write(points, options);
+        }
+        expected.insert(expected.end(), points.begin(), points.end());
+        starts.push_back(expected.size());
+    }
+    PlyBatchReader<CustomVertex> reader;
+    std::vector<CustomVertex> vertices;
+    std::vector<uint64_t> offsets;
+    reader.read(paths, vertices, offsets, 4);
+    PLY_CHECK(offsets == starts);
+    // 量化的瓦片顺序会变，单独按集合比较
+    bool ordered = vertices.size() == expected.size();
+    for (size_t i = 0; ordered && i < vertices.size(); i++) {
+        ordered = (i >= starts[9] && i < starts[10]) || sameVertex(vertices[i], expected[i]);
+    }
+    PLY_CHECK(ordered);
+    PLY_CHECK(sameSet(std::vector<CustomVertex>(vertices.begin() + starts[9], vertices.begin() + starts[10]),
+                      std::vector<CustomVertex>(expected.begin() + starts[9], expected.begin() + starts[10])));
+    PLY_CHECK(reader.cachedPlans() == 2);
+    reader.read(paths, vertices, offsets, 1);
+    PLY_CHECK(reader.cachedPlans() == 2 && offsets == starts);
+    reader.read(std::vector<std::string>(), vertices, offsets, 4);
+    PLY_CHECK(vertices.empty() && offsets == std::vector<uint64_t>{0});
+
+    // vertex 元素带列表属性、文件缺失或截断时报错；前两者在读取头部时就拒绝，不改动输出
+    const std::string list = dir + "/tile_list.ply";
+    std::string record;
+    for (float v : {1.0f, 2.0f, 3.0f}) appendValue(record, v);
+    appendValue<uint8_t>(record, 1);
+    appendValue<int32_t>(record, 7);
+    writeRaw(list, "ply\nformat binary_little_endian 1.0\nelement vertex 1\nproperty float x\nproperty float y\n"
+                   "property float z\nproperty list uchar int ids\nend_header\n", record.data(), record.size());
+    vertices.assign(3, CustomVertex());
+    offsets.clear();
+    std::vector<std::string> withList = paths;
+    withList.push_back(list);
+    PLY_CHECK_THROWS(reader.read(withList, vertices, offsets, 4), std::runtime_error);
+    PLY_CHECK(vertices.size() == 3 && offsets.empty());
+    std::vector<std::string> withMissing = paths;
+    withMissing.insert(withMissing.begin() + 3, dir + "/tile_missing.ply");
+    PLY_CHECK_THROWS(reader.read(withMissing, vertices, offsets, 4), std::runtime_error);
+    PLY_CHECK(vertices.size() == 3 && offsets.empty());
+    PLY_CHECK(::truncate(paths[4].c_str(), static_cast<off_t>(fileSize(paths[4]) - 15)) == 0);
+    PLY_CHECK_THROWS(reader.read(paths, vertices, offsets, 4), std::runtime_error);
+    for (const auto& path : withList) ::unlink(path.c_str());
+}
+
+static std::vector<TestPadded> makePadded(size_t count) {
+    std::vector<TestPadded> points(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t h = testHash(i);
+        std::memset(&points[i], 0, sizeof(TestPadded));
+        points[i].x = static_cast<double>(h % 100000) * 0.001;
+        points[i].y = static_cast<double>(h >> 20 & 0xffff) * 0.01;
+        points[i].z = -static_cast<double>(i);
+        points[i].intensity = static_cast<float>(h >> 40 & 0xff) / 255.0f;
+        points[i].label = static_cast<unsigned short>(h >> 48);
+    }
+    return points;
+}
+
+// 读取时降采样：抽取（步长 1、超过点数）、随机（与线程数无关，比例 0 和 1）、体素平均（整数字段四舍五入、
+// 跳过非有限坐标）；跨越多个预读段、大端文件、空文件；非法的体素大小和缺少坐标的文件
+static void testDecimation() {
+    std::vector<CustomVertex> points = makeCloud(200000, 8);
+    const std::string file = dir + "/decimate.ply";
+    writeBigEndian(file, points);
+    const PlyReader reader(file);
+
+    std::vector<CustomVertex> strided;
+    PLY_CHECK(reader.readDecimated(PlyDecimation::everyNth(7), strided, 3) == (points.size() + 6) / 7);
+    bool stridedMatch = strided.size() == (points.size() + 6) / 7;
+    for (size_t i = 0; stridedMatch && i < strided.size(); i++) stridedMatch = sameVertex(strided[i], points[i * 7]);
+    PLY_CHECK(stridedMatch);
+    PLY_CHECK(reader.readDecimated(PlyDecimation::everyNth(0), strided, 2) == points.size() && sameVertices(strided, points));
+    PLY_CHECK(reader.readDecimated(PlyDecimation::everyNth(points.size() + 5), strided, 2) == 1 && sameVertex(strided[0], points[0]));
+
+    const PlyDecimation random = PlyDecimation::random(0.1, 42);
+    std::vector<CustomVertex> one, four, expected;
+    reader.readDecimated(random, one, 1);
+    reader.readDecimated(random, four, 4);
+    for (size_t i = 0; i < points.size(); i++) {
+        if (random.keep(i)) expected.push_back(points[i]);
+    }
+    PLY_CHECK(sameVertices(one, expected) && sameVertices(four, expected));
+    PLY_CHECK(reader.readDecimated(PlyDecimation::random(0), one, 2) == 0 && one.empty());
+    PLY_CHECK(reader.readDecimated(PlyDecimation::random(1), one, 2) == points.size() && sameVertices(one, points));
+
+    // 体素：逐个与暴力平均比较；非有限坐标的点不计入
+    points[5].x = std::numeric_limits<float>::quiet_NaN();
+    points[77].z = -std::numeric_limits<float>::infinity();
+    PlyBinaryIO(file).write(points);
+    const double size = 4;
+    std::map<std::tuple<int64_t, int64_t, int64_t>, std::array<double, 7>> cells;
+    for (const auto& p : points) {
+        if (!std::isfinite(p.x) || !std::isfinite(p.z)) continue;
+        auto& sum = cells[std::make_tuple(static_cast<int64_t>(std::floor(p.x / size)), static_cast<int64_t>(std::floor(p.y / size)),
+                                          static_cast<int64_t>(std::floor(p.z / size)))];
+        const double values[6] = {p.x, p.y, p.z, double(p.r), double(p.g), double(p.b)};
+        for (int k = 0; k < 6; k++) sum[k] += values[k];
+        sum[6]++;
+    }
+    std::vector<CustomVertex> voxels;
+    PLY_CHECK(PlyReader(file).readDecimated(PlyDecimation::voxelGrid(size), voxels, 4) == cells.size());
+    bool averaged = voxels.size() == cells.size();
+    auto cell = cells.begin();
+    for (size_t i = 0; averaged && i < voxels.size(); i++, ++cell) {
+        const auto& sum = cell->second;
+        const CustomVertex& v = voxels[i];
+        averaged = std::abs(v.x - sum[0] / sum[6]) < 1e-3 && std::abs(v.y - sum[1] / sum[6]) < 1e-3 &&
+                   std::abs(v.z - sum[2] / sum[6]) < 1e-3 && v.r == std::round(sum[3] / sum[6]) &&
+                   v.g == std::round(sum[4] / sum[6]) && v.b == std::round(sum[5] / sum[6]);
+    }
+    PLY_CHECK(averaged);
+    PLY_CHECK_THROWS(PlyReader(file).readDecimated(PlyDecimation::voxelGrid(0), voxels, 1), std::invalid_argument);
+    PLY_CHECK_THROWS(PlyReader(file).readDecimated(PlyDecimation::voxelGrid(-1), voxels, 1), std::invalid_argument);
+
+    // 跨越多个预读段（每段 8MB）时各段写到各自的位置
+    const std::vector<TestPadded> padded = makePadded(700001);
+    PlyBinaryIO(file).write(padded);
+    const PlyReader large(file);
+    std::vector<TestPadded> largeStrided, largeRandom;
+    PLY_CHECK(large.readDecimated(PlyDecimation::everyNth(7), largeStrided, 3) == (padded.size() + 6) / 7);
+    large.readDecimated(random, largeRandom, 3);
+    bool largeMatch = largeStrided.size() == (padded.size() + 6) / 7;
+    for (size_t i = 0; largeMatch && i < largeStrided.size(); i++) largeMatch = sameVertex(largeStrided[i], padded[i * 7]);
+    size_t next = 0;
+    for (size_t i = 0; largeMatch && i < padded.size(); i++) {
+        if (random.keep(i)) largeMatch = next < largeRandom.size() && sameVertex(largeRandom[next++], padded[i]);
+    }
+    PLY_CHECK(largeMatch && next == largeRandom.size());
+
+    PlyBinaryIO(file).write(std::vector<CustomVertex>());
+    PLY_CHECK(PlyReader(file).readDecimated(PlyDecimation::everyNth(3), strided, 2) == 0 && strided.empty());
+    PLY_CHECK(PlyReader(file).readDecimated(PlyDecimation::voxelGrid(1), voxels, 2) == 0 && voxels.empty());
+    writeRaw(file, "ply\nformat binary_little_endian 1.0\nelement vertex 0\nproperty float x\nproperty float y\nend_header\n");
+    PLY_CHECK_THROWS(PlyReader(file).readDecimated(PlyDecimation::voxelGrid(1), voxels, 1), std::runtime_error);
+    ::unlink(file.c_str());
+}
+
+// 按 PlyCloudStats::Histogram 的分格规则暴力统计，用来核对直方图
+static bool sameHistogram(const PlyCloudStats::Histogram& histogram, const std::vector<double>& values) {
+    std::vector<uint64_t> bins(histogram.bins.size(), 0);
+    uint64_t outside = 0;
+    const double scale = bins.size() / (histogram.max - histogram.min);
+    for (double value : values) {
+        if (!(value >= histogram.min && value <= histogram.max)) {
+            outside++;
+            continue;
+        }
+        bins[std::min(bins.size() - 1, static_cast<size_t>((value - histogram.min) * scale))]++;
+    }
+    return bins == histogram.bins && outside == histogram.outside;
+}
+
+static bool sameStats(const PlyCloudStats& a, const PlyCloudStats& b) {
+    if (a.count != b.count || a.nonFinite != b.nonFinite || a.bounds.min != b.bounds.min || a.bounds.max != b.bounds.max ||
+        a.histograms.size() != b.histograms.size()) {
+        return false;
+    }
+    for (size_t h = 0; h < a.histograms.size(); h++) {
+        if (a.histograms[h].bins != b.histograms[h].bins || a.histograms[h].outside != b.histograms[h].outside) return false;
+    }
+    return true;
+}
+
+// 读写时顺带统计：非有限坐标不计入包围盒，直方图与暴力统计一致；各种格式、线程数结果相同
+static void testCloudStats() {
+    std::vector<CustomVertex> points = makeCloud(120001, 9);
+    points[5].x = std::numeric_limits<float>::quiet_NaN();
+    points[777].z = std::numeric_limits<float>::infinity();
+    points[90000].y = -std::numeric_limits<float>::infinity();
+    PlyBounds expected;
+    std::vector<double> zs, reds;
+    for (const auto& p : points) {
+        if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) expected.expand(PlyPosition{p.x, p.y, p.z});
+        zs.push_back(p.z);
+        reds.push_back(p.r);
+    }
+    const std::string file = dir + "/stats.ply";
+    PlyCloudStats written;
+    written.addHistogram("z", 0, 8, 16);
+    written.addHistogram("r", 0, 255, 10);
+    PlyWriteOptions options;
+    options.cloudStats = &written;
+    options.boundsInHeader = true;
+    options.threads = 3;
+    PlyBinaryIO(file).write(points, options);
+    PLY_CHECK(written.count == points.size() && written.nonFinite == 3);
+    PLY_CHECK(written.bounds.min == expected.min && written.bounds.max == expected.max);
+    PLY_CHECK(sameHistogram(written.histograms[0], zs) && sameHistogram(written.histograms[1], reds));
+    // 头部的包围盒回填后仍可读，数据位置不变
+    const PlyReader reader(file);
+    PLY_CHECK(reader.header().hasBounds && reader.header().bounds.min == expected.min && reader.header().bounds.max == expected.max);
+    std::vector<CustomVertex> vertices;
+    PlyBinaryIO(file).read(vertices);
+    PLY_CHECK(vertices.size() == points.size() && sameVertex(vertices[1], points[1]) && std::isnan(vertices[5].x));
+
+    // 读取时统计：线程数不影响结果，也与写入时一致；大端文件先换字节序再统计
+    for (size_t threads : {1, 4}) {
+        PlyCloudStats read = written;
+        reader.read(vertices, read, threads);
+        PLY_CHECK(sameStats(read, written));
+    }
+    writeBigEndian(file, points);
+    PlyCloudStats bigEndian = written;
+    PlyBinaryIO(file).read(vertices, bigEndian);
+    PLY_CHECK(sameStats(bigEndian, written));
+
+    // ASCII、量化和按列写入的路径（量化不接受非有限坐标，用干净的点云）
+    const std::vector<CustomVertex> clean = makeCloud(50000, 10);
+    PlyCloudStats cleanStats;
+    PlyWriteOptions plain;
+    plain.cloudStats = &cleanStats;
+    PlyBinaryIO(file).write(clean, plain);
+    PLY_CHECK(cleanStats.count == clean.size() && cleanStats.nonFinite == 0 && cleanStats.histograms.empty());
+    PlyWriteOptions ascii = plain;
+    ascii.ascii = true;
+    PlyCloudStats asciiWritten;
+    ascii.cloudStats = &asciiWritten;
+    ascii.boundsInHeader = true;
+    PlyBinaryIO(file).write(clean, ascii);
+    PLY_CHECK(sameStats(asciiWritten, cleanStats) && PlyReader::readHeader(file).bounds.max == cleanStats.bounds.max);
+    PlyCloudStats asciiRead;
+    PlyBinaryIO(file).read(vertices, asciiRead);
+    PLY_CHECK(sameStats(asciiRead, cleanStats) && sameVertices(vertices, clean));
+    PlyWriteOptions quantized = ascii;
+    quantized.ascii = false;
+    quantized.quantization = 1.0 / 1024;
+    PlyCloudStats quantizedWritten;
+    quantized.cloudStats = &quantizedWritten;
+    PlyBinaryIO(file).write(clean, quantized);
+    PLY_CHECK(sameStats(quantizedWritten, cleanStats) && PlyReader::readHeader(file).bounds.min == cleanStats.bounds.min);
+    PlyCloudStats quantizedRead;
+    PlyBinaryIO(file).read(vertices, quantizedRead);
+    PLY_CHECK(sameStats(quantizedRead, cleanStats));
+    PlyCloudStats columnStats;
+    PlyWriteOptions columnOptions;
+    columnOptions.cloudStats = &columnStats;
+    columnOptions.littleEndian = false;
+    PlyBinaryIO(file).write(clean);
+    const PlyColumns columns = PlyReader(file).readColumns<CustomVertex>();
+    PlyBinaryIO(file).writeColumns(columns, columnOptions);
+    PLY_CHECK(sameStats(columnStats, cleanStats));
+
+    // 空点云：包围盒为空，头部的包围盒行同样定宽、可解析
+    PlyCloudStats emptyStats;
+    options.cloudStats = &emptyStats;
+    PlyBinaryIO(file).write(std::vector<CustomVertex>(), options);
+    PLY_CHECK(emptyStats.count == 0 && emptyStats.bounds.empty() && PlyReader(file).header().bounds.empty());
+
+    // 直方图的范围无效、属性不存在时报错
+    PlyCloudStats invalid;
+    PLY_CHECK_THROWS(invalid.addHistogram("z", 1, 1, 4), std::invalid_argument);
+    PLY_CHECK_THROWS(invalid.addHistogram("z", 0, 1, 0), std::invalid_argument);
+    invalid.addHistogram("intensity", 0, 1, 4);
+    options.cloudStats = &invalid;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(clean, options), std::invalid_argument);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).read(vertices, invalid), std::invalid_argument);
+
+    // 追加写入：每次落盘回填包围盒；模拟数据已落盘但包围盒未回填时退出，修复时按保留的数据重新计算
+    PlyWriteOptions appendOptions;
+    appendOptions.boundsInHeader = true;
+    {
+        PlyAppendWriter<CustomVertex> writer(file, appendOptions, 1000);
+        writer.append(clean);
+    }
+    PlyReader appended(file);
+    PLY_CHECK(appended.header().bounds.min == cleanStats.bounds.min && appended.header().bounds.max == cleanStats.bounds.max);
+    CustomVertex outside = clean[0];
+    outside.x = 1000;
+    {
+        std::ofstream grow(file, std::ios::binary | std::ios::app);
+        grow.write(reinterpret_cast<const char*>(&outside), sizeof(outside));
+        grow.write("\1\2", 2);
+    }
+    PLY_CHECK(recoverAppendedPly(file) == clean.size() + 1);
+    const PlyHeader recovered = PlyReader(file).header();
+    PLY_CHECK(recovered.hasBounds && recovered.bounds.max[0] == 1000 && recovered.bounds.min == cleanStats.bounds.min);
+    PLY_CHECK(recovered.dataOffset == appended.header().dataOffset && PlyReader(file).vertexCount() == clean.size() + 1);
+    ::unlink(file.c_str());
+}
+
+// 不解码的拆分、合并、裁剪：字节序、布局不同的输入合并时转换；输出不能覆盖输入
+static void testMergeSplitCrop() {
+    const std::vector<CustomVertex> points = makeCloud(100003, 5);
+    const std::string file = dir + "/whole.ply";
+    PlyWriteOptions options;
+    options.boundsInHeader = true;
+    PlyBinaryIO(file).write(points, options);
+
+    // 不能整除时前面的文件各多一个顶点
+    std::vector<std::string> parts;
+    for (int i = 0; i < 3; i++) parts.push_back(dir + "/part" + std::to_string(i) + ".ply");
+    splitPly(file, parts, 2);
+    PLY_CHECK(PlyReader::readHeader(parts[0]).vertexCount == 33335 && PlyReader::readHeader(parts[2]).vertexCount == 33334);
+    std::vector<CustomVertex> read;
+    PlyBinaryIO(parts[1]).read(read);
+    PLY_CHECK(sameVertices(read, std::vector<CustomVertex>(points.begin() + 33335, points.begin() + 66669)));
+
+    // 第二块改写成大端，合并时需要转换；各块都没有包围盒时输出也没有
+    PlyWriteOptions bigEndian;
+    bigEndian.littleEndian = false;
+    PlyBinaryIO(parts[1]).write(read, bigEndian);
+    const std::string merged = dir + "/merged.ply";
+    PLY_CHECK(mergePly(parts, merged, 3) == points.size());
+    PlyBinaryIO(merged).read(read);
+    PLY_CHECK(sameVertices(read, points) && !PlyReader::readHeader(merged).hasBounds);
+    PLY_CHECK(PlyReader::readHeader(merged).littleEndian);
+
+    // 布局不同的输入：缺少的属性补零；全部输入带包围盒时输出合并后的包围盒
+    const std::string narrow = dir + "/narrow.ply";
+    std::vector<TestPartial> partial(1000);
+    for (size_t i = 0; i < partial.size(); i++) partial[i] = TestPartial{-1.0f * i, 2, 3, 0};
+    PlyBinaryIO(narrow).write(partial, options);
+    PLY_CHECK(mergePly({file, narrow}, merged, 2) == points.size() + partial.size());
+    PlyBinaryIO(merged).read(read);
+    PLY_CHECK(sameVertices(std::vector<CustomVertex>(read.begin(), read.begin() + points.size()), points));
+    PLY_CHECK(read.back().x == -999.0f && read.back().y == 2 && read.back().r == 0 && read.back().b == 0);
+    const PlyHeader mergedHeader = PlyReader::readHeader(merged);
+    PLY_CHECK(mergedHeader.hasBounds && mergedHeader.bounds.min[0] == -999.0f &&
+              mergedHeader.bounds.max == PlyReader::readHeader(file).bounds.max);
+
+    const std::string cropped = dir + "/cropped.ply";
+    cropPly(file, cropped, 50000, 1234);
+    PlyBinaryIO(cropped).read(read);
+    PLY_CHECK(sameVertices(read, std::vector<CustomVertex>(points.begin() + 50000, points.begin() + 51234)));
+    cropPly(file, cropped, points.size(), 0);
+    PLY_CHECK(PlyReader(cropped).vertexCount() == 0);
+    PLY_CHECK_THROWS(cropPly(file, cropped, 100000, 10), std::out_of_range);
+    PLY_CHECK_THROWS(cropPly(file, cropped, 1, points.size()), std::out_of_range);
+
+    // 面片不随顶点复制
+    const PlyFaceList faces = makeFaces(points.size());
+    const std::string meshed = dir + "/meshed.ply";
+    PlyBinaryIO(meshed).write(points, faces);
+    cropPly(meshed, cropped, 10, 100);
+    PLY_CHECK(PlyReader::readHeader(cropped).elements.size() == 1 && fileSize(cropped) == PlyReader(cropped).header().dataOffset + 1500);
+
+    // 输出是输入之一（包括换一种写法的路径和硬链接）或输出重复时拒绝，源文件不变
+    const std::string link = dir + "/whole_link.ply";
+    PLY_CHECK(::link(file.c_str(), link.c_str()) == 0);
+    const size_t size = fileSize(file);
+    PLY_CHECK_THROWS(cropPly(file, file, 0, 10), std::invalid_argument);
+    PLY_CHECK_THROWS(cropPly(file, dir + "/./whole.ply", 0, 10), std::invalid_argument);
+    PLY_CHECK_THROWS(cropPly(file, link, 0, 10), std::invalid_argument);
+    PLY_CHECK_THROWS(mergePly(parts, parts[2]), std::invalid_argument);
+    PLY_CHECK_THROWS(splitPly(file, {parts[0], file}), std::invalid_argument);
+    PLY_CHECK_THROWS(splitPly(file, {dir + "/new.ply", dir + "/new.ply"}), std::invalid_argument);
+    PLY_CHECK(fileSize(file) == size && PlyReader::readHeader(parts[2]).vertexCount == 33334 && !fileExists(dir + "/new.ply"));
+
+    // 只接受未压缩的二进制文件
+    PlyWriteOptions ascii;
+    ascii.ascii = true;
+    PlyBinaryIO(narrow).write(partial, ascii);
+    PLY_CHECK_THROWS(mergePly({file, narrow}, merged), std::runtime_error);
+    PLY_CHECK_THROWS(mergePly({}, merged), std::invalid_argument);
+    PLY_CHECK_THROWS(splitPly(file, {}), std::invalid_argument);
+
+    for (const auto& path : parts) ::unlink(path.c_str());
+    for (const auto& path : {file, merged, cropped, narrow, meshed, link}) ::unlink(path.c_str());
+}
+
+// 相邻顶点的距离之和，用来衡量写出顺序的空间局部性
+static double pathLength(const std::vector<CustomVertex>& points) {
+    double length = 0;
+    for (size_t i = 1; i < points.size(); i++) {
+        length += std::abs(points[i].x - points[i - 1].x) + std::abs(points[i].y - points[i - 1].y) +
+                  std::abs(points[i].z - points[i - 1].z);
+    }
+    return length;
+}
+
+// 按空间顺序写出：内容不变、面片仍指向原来的顶点、局部性明显变好；写入时生成的块索引与扫描建立的一致
+static void testSpatialOrder() {
+    const std::vector<CustomVertex> points = makeCloud(50000, 3);
+    const PlyFaceList faces = makeFaces(points.size());
+    const std::string file = dir + "/ordered.ply";
+    for (PlySpatialOrder order : {PlySpatialOrder::kMorton, PlySpatialOrder::kHilbert}) {
+        for (bool ascii : {false, true}) {
+            PlyWriteOptions options;
+            options.order = order;
+            options.ascii = ascii;
+            options.littleEndian = false;
+            options.threads = 3;
+            PlyBinaryIO(file).write(points, faces, options);
+            std::vector<CustomVertex> vertices;
+            PlyBinaryIO(file).read(vertices);
+            PLY_CHECK(sameSet(vertices, points) && pathLength(vertices) * 4 < pathLength(points));
+            if (ascii) continue;  // ASCII 的面片只写不读
+            PlyFaceList read;
+            PlyReader(file).readFaces(read);
+            bool sameCorners = read.offsets == faces.offsets;
+            for (size_t k = 0; sameCorners && k < faces.indices.size(); k++) {
+                sameCorners = sameVertex(vertices[read.indices[k]], points[faces.indices[k]]);
+            }
+            PLY_CHECK(sameCorners);
+        }
+    }
+
+    // 有填充的结构体、非有限坐标排到最后、调用方的数组不变；空点云
+    std::vector<TestPadded> padded = makePadded(3000);
+    padded[10].y = std::numeric_limits<double>::quiet_NaN();
+    const std::vector<TestPadded> before = padded;
+    PlyWriteOptions hilbert;
+    hilbert.order = PlySpatialOrder::kHilbert;
+    PlyBinaryIO(file).write(padded, hilbert);
+    std::vector<TestPadded> paddedRead;
+    PlyBinaryIO(file).read(paddedRead);
+    PLY_CHECK(paddedRead.size() == padded.size() && std::isnan(paddedRead.back().y) && paddedRead.back().label == padded[10].label);
+    PLY_CHECK(std::isnan(padded[10].y) && sameVertex(padded[11], before[11]) && sameVertex(padded[0], before[0]));
+    PlyBinaryIO(file).write(std::vector<CustomVertex>(), hilbert);
+    PLY_CHECK(PlyReader(file).vertexCount() == 0);
+
+    // 写入时生成块索引，与扫描建立的索引逐块相同，包围盒查询直接使用
+    const std::string sidecar = PlyChunkIndex::sidecarPath(file);
+    PlyWriteOptions indexed = hilbert;
+    indexed.chunkIndexVertices = 4096;
+    PlyBinaryIO(file).write(points, indexed);
+    PLY_CHECK(fileExists(sidecar));
+    const PlyReader reader(file);
+    PlyChunkIndex saved;
+    PLY_CHECK(saved.load(sidecar, reader));
+    const PlyChunkIndex scanned = PlyChunkIndex::build(reader, 4096);
+    bool sameIndex = saved.chunks() == (points.size() + 4095) / 4096 && saved.chunks() == scanned.chunks();
+    for (size_t c = 0; sameIndex && c < saved.chunks(); c++) {
+        sameIndex = saved.bounds(c).min == scanned.bounds(c).min && saved.bounds(c).max == scanned.bounds(c).max;
+    }
+    PLY_CHECK(sameIndex);
+    PlyBounds box;
+    box.min = {{10, 20, 0}};
+    box.max = {{30, 40, 8}};
+    std::vector<CustomVertex> hits;
+    PlyBinaryIO(file).readBox(box, hits);
+    PLY_CHECK(sameSet(hits, insideBox(points, box)));
+
+    // 不支持的组合在打开文件前拒绝
+    size_t size = fileSize(file);
+    PlyWriteOptions asciiIndexed = indexed;
+    asciiIndexed.ascii = true;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(points, asciiIndexed), std::invalid_argument);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).writeColumns(reader.readColumns<CustomVertex>(), hilbert), std::invalid_argument);
+    PLY_CHECK_THROWS(PlyAppendWriter<CustomVertex>(file, hilbert), std::invalid_argument);
+    PLY_CHECK(fileSize(file) == size && fileExists(sidecar));
+
+    // 越界、超出 int32 的下标和不合法的偏移在打开文件前拒绝，无论是否重新排序
+    PlyFaceList bad = faces;
+    bad.indices[4] = static_cast<uint32_t>(points.size());
+    for (PlySpatialOrder order : {PlySpatialOrder::kNone, PlySpatialOrder::kHilbert}) {
+        PlyWriteOptions options;
+        options.order = order;
+        PLY_CHECK_THROWS(PlyBinaryIO(file).write(points, bad, options), std::out_of_range);
+    }
+    bad.indices[4] = 0x80000000u;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(points, bad), std::out_of_range);
+    bad = faces;
+    bad.offsets.back()++;
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(points, bad), std::invalid_argument);
+    bad = faces;
+    std::swap(bad.offsets[1], bad.offsets[2]);
+    PLY_CHECK_THROWS(PlyBinaryIO(file).write(points, bad), std::invalid_argument);
+    PLY_CHECK(fileSize(file) == size);
+    ::unlink(file.c_str());
+    ::unlink(sidecar.c_str());
+}
+
+// LOD 八叉树：选出的节点互不重叠且合起来恰好是全部有限坐标的点；节点文件与列表一致；中断留下的临时文件不混入
+static void testLod() {
+    std::vector<CustomVertex> points = makeCloud(30000, 10);
+    points[3].y = std::numeric_limits<float>::quiet_NaN();
+    points[4].z = std::numeric_limits<float>::infinity();
+    std::vector<CustomVertex> finite;
+    for (const auto& p : points) {
+        if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)) finite.push_back(p);
+    }
+    const std::string input = dir + "/lod_input.ply";
+    PlyWriteOptions writeOptions;
+    writeOptions.boundsInHeader = true;
+    PlyBinaryIO(input).write(points, writeOptions);
+
+    const std::string lod = dir + "/lod";
+    ::mkdir(lod.c_str(), 0755);
+    {
+        std::ofstream stale(lod + "/.partition0.tmp", std::ios::binary);
+        stale << std::string(1 << 16, '\x7f');
+    }
+    PlyLodOptions options;
+    options.maxNodePoints = 512;
+    options.partitionLevels = 1;
+    options.threads = 3;
+    const PlyLodIndex built = buildPlyLod<CustomVertex>(input, lod, options);
+    const PlyLodIndex index = PlyLodIndex::load(lod);
+    PLY_CHECK(index.nodes().size() == built.nodes().size() && !index.nodes().empty());
+    PLY_CHECK(index.cube().min == built.cube().min && index.cube().max == built.cube().max);
+    PLY_CHECK(!fileExists(lod + "/.partition0.tmp"));
+
+    // 每个节点文件的点数与列表一致，点都在节点的立方体内，内部节点不超过 maxNodePoints
+    bool nodesMatch = true;
+    for (const auto& node : index.nodes()) {
+        std::vector<CustomVertex> nodePoints;
+        PlyReader(PlyLodIndex::nodePath(lod, node.name)).read(nodePoints);
+        nodesMatch = nodesMatch && nodePoints.size() == node.count && insideBox(nodePoints, index.bounds(node.name)).size() == node.count;
+        const bool internal = std::any_of(index.nodes().begin(), index.nodes().end(), [&](const PlyLodIndex::Node& other) {
+            return other.name.size() == node.name.size() + 1 && other.name.compare(0, node.name.size(), node.name) == 0;
+        });
+        if (internal) nodesMatch = nodesMatch && node.count <= options.maxNodePoints;
+    }
+    PLY_CHECK(nodesMatch);
+
+    // 整个立方体、最细一层：叶节点合起来就是全部有限点，节点名互不为前缀
+    std::vector<CustomVertex> frontier;
+    const auto leaves = index.select(index.cube(), 64);
+    bool disjoint = true;
+    for (const PlyLodIndex::Node* node : leaves) {
+        std::vector<CustomVertex> nodePoints;
+        PlyReader(PlyLodIndex::nodePath(lod, node->name)).read(nodePoints);
+        frontier.insert(frontier.end(), nodePoints.begin(), nodePoints.end());
+        for (const PlyLodIndex::Node* other : leaves) {
+            if (other != node && other->name.compare(0, node->name.size(), node->name) == 0) disjoint = false;
+        }
+    }
+    PLY_CHECK(disjoint && sameSet(frontier, finite));
+
+    // 最粗一层只有根节点；小范围的查询只返回与它相交的节点，且覆盖范围内的全部点
+    const auto root = index.select(index.cube(), 0);
+    PLY_CHECK(root.size() == 1 && root[0]->name == "r" && root[0]->count <= options.maxNodePoints);
+    PlyBounds box;
+    box.min = {{5, 5, 1}};
+    box.max = {{12, 9, 3}};
+    std::vector<CustomVertex> covered;
+    bool intersecting = true;
+    for (const PlyLodIndex::Node* node : index.select(box, 64)) {
+        intersecting = intersecting && index.bounds(node->name).intersects(box);
+        std::vector<CustomVertex> nodePoints;
+        PlyReader(PlyLodIndex::nodePath(lod, node->name)).read(nodePoints);
+        const std::vector<CustomVertex> inside = insideBox(nodePoints, box);
+        covered.insert(covered.end(), inside.begin(), inside.end());
+    }
+    PLY_CHECK(intersecting && sameSet(covered, insideBox(finite, box)));
+    PLY_CHECK(index.find("r") == &index.nodes()[0] && index.find("r9") == nullptr && index.find("") == nullptr);
+    removeTree(lod);
+
+    // 直接追加：跳过非有限点；maxDepth 为 0 时根节点保存全部点；没有点时没有节点
+    PlyLodOptions flat = options;
+    flat.bounds = built.cube();
+    flat.maxDepth = 0;
+    {
+        PlyLodWriter<CustomVertex> writer(lod, flat);
+        writer.append(points);
+        PLY_CHECK(writer.count() == points.size() && writer.skipped() == 2);
+        const PlyLodIndex& single = writer.close();
+        PLY_CHECK(single.nodes().size() == 1 && single.nodes()[0].count == finite.size());
+        PLY_CHECK_THROWS(writer.append(points), std::logic_error);
+    }
+    removeTree(lod);
+    {
+        PlyLodWriter<CustomVertex> writer(lod, flat);
+        PLY_CHECK(writer.close().nodes().empty() && PlyLodIndex::load(lod).select(flat.bounds, 64).empty());
+    }
+    removeTree(lod);
+
+    // 选项不合法、索引文件损坏时报错
+    PLY_CHECK_THROWS(PlyLodWriter<CustomVertex>(lod, PlyLodOptions()), std::invalid_argument);
+    PlyLodOptions tiny = flat;
+    tiny.maxNodePoints = 4;
+    PLY_CHECK_THROWS(PlyLodWriter<CustomVertex>(lod, tiny), std::invalid_argument);
+    ::mkdir(lod.c_str(), 0755);
+    writeRaw(PlyLodIndex::indexPath(lod), "ply_lod 1\ncube 0 0 0 1 1 1\nnodes 3\nr 10\n");
+    PLY_CHECK_THROWS(PlyLodIndex::load(lod), std::runtime_error);
+    writeRaw(PlyLodIndex::indexPath(lod), "ply_lod 2\n");
+    PLY_CHECK_THROWS(PlyLodIndex::load(lod), std::runtime_error);
+    removeTree(lod);
+    ::unlink(input.c_str());
+}
+
+int main(int argc, char** argv) {
+    std::string base = argc > 1 ? argv[1] : "/tmp/ply_test_XXXXXX";
+    if (argc > 1) {
+        ::mkdir(base.c_str(), 0755);
+        dir = base;
+    } else {
+        if (!::mkdtemp(&base[0])) {
+            std::cerr << "Failed to create temporary directory" << std::endl;
+            return 1;
+        }
+        dir = base;
+    }
+
+    const std::vector<std::pair<const char*, std::function<void()>>> tests = {
+        {"mapped_read", testMappedRead},
+        {"converting_read", testConvertingRead},
+        {"byte_order", testByteOrder},
+        {"asc_file", testAscFile},
+        {"batches", testBatches},
+        {"range_read", testRangeRead},
+        {"columns", testColumns},
+        {"projection", testProjection},
+        {"parallel_write", testParallelWrite},
+        {"append", testAppend},
+        {"faces", testFaces},
+        {"schema", testSchema},
+        {"ascii", testAscii},
+        {"box_query", testBoxQuery},
+        {"quantized", testQuantized},
+        {"read_ahead", testReadAhead},
+        {"io_stats", testIOStats},
+        {"uninitialized", testUninitialized},
+        {"batch_reader", testBatchReader},
+        {"decimation", testDecimation},
+        {"cloud_stats", testCloudStats},
+        {"merge_split_crop", testMergeSplitCrop},
+        {"spatial_order", testSpatialOrder},
+        {"lod", testLod},
+    };
+    for (const auto& test : tests) {
+        const int before = failures;
+        try {
+            test.second();
+        } catch (const std::exception& e) {
+            std::cerr << test.first << ": unexpected exception: " << e.what() << std::endl;
+            failures++;
+        }
+        std::cout << (failures == before ? "ok   " : "FAIL ") << test.first << std::endl;
+    }
+    if (argc <= 1) removeTree(dir);
+    return failures == 0 ? 0 : 1;
+}